@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// fixed size ring allocator over the bitstream buffer
+// frames are pushed in decode order and released from the front once decoded,
+// a frame never straddles the end of the buffer
+class BitstreamRing {
+private:
+	struct Entry {
+		uint32_t frame;
+		uint64_t offset;
+		uint64_t consumed;	// aligned size plus the tail skipped on wrap
+	};
+
+	uint64_t capacity = 0;
+	uint64_t alignment = 1;
+
+	uint64_t head = 0;	// next write position
+	uint64_t used = 0;
+
+	// entries in a fixed ring, nothing is allocated per frame
+	std::vector<Entry> entries;
+	uint32_t firstEntry = 0;
+	uint32_t entriesCount = 0;
+
+	Entry& getEntry(uint32_t i) { return entries[(firstEntry + i) % entries.size()]; }
+
+public:
+	// maxFrames bounds the frames resident at once (the track frames count)
+	BitstreamRing(uint64_t capacity, uint64_t alignment, uint32_t maxFrames);
+
+	// reserve space for a frame, returns false when the ring is full
+	bool push(uint32_t frame, uint64_t size, uint64_t& offset);
+	void pop();
+	void clear();
+
+	bool empty() const { return entriesCount == 0; }
+	uint32_t frontFrame() const { return entries[firstEntry].frame; }
+	bool contains(uint32_t frame) const;
+	uint64_t getCapacity() const { return capacity; }
+	uint64_t getUsed() const { return used; }
+};
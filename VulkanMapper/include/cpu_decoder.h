@@ -0,0 +1,88 @@
+#pragma once
+
+#ifdef VM_CPU_DECODE
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+struct AVCodecContext;
+struct AVFrame;
+
+// upper bound of decoder threads, with frame threading each thread holds back one frame
+#define CPU_DECODE_MAX_THREADS 8
+
+// raw sps & pps nal units of the h264 track of an mp4 as annex-b
+std::vector<uint8_t> readParameterSets(const std::string& filePath);
+
+// software h264 decode (libavcodec) on a worker thread, the decoder frame and slice threads across cores
+// pictures are written as nv12 (luma plane, then interleaved chroma) into host memory slots
+// owned by the caller, no graphics api involved
+class CpuDecoder {
+private:
+	AVCodecContext* pCodecContext = nullptr;
+	uint32_t threadCount = 1;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t* pSlots = nullptr;
+	uint64_t slotSize = 0;
+
+	struct DecodeJob {
+		uint64_t sequence;
+		uint32_t slot;
+		const uint8_t* pData;
+		uint32_t size;
+	};
+
+	// worker
+	std::thread worker;
+	std::mutex jobsMutex;
+	std::condition_variable jobsCondition;
+	std::deque<DecodeJob> jobs;					// not yet sent to the decoder
+	bool flushing = false;
+	bool stopping = false;
+	std::vector<uint64_t> slotDecodedSequence;	// guarded by jobsMutex
+	uint64_t nextSequence = 1;
+
+	void workerLoop();
+	void receiveFrames(AVFrame* pFrame, std::vector<DecodeJob>& sentJobs);
+	void writeFrame(AVFrame* pFrame, uint32_t slot);
+	void markDecoded(const DecodeJob& job);
+
+public:
+	// threadCount = 0 uses all hardware threads, up to CPU_DECODE_MAX_THREADS
+	CpuDecoder(uint32_t threadCount = 0);
+	~CpuDecoder();
+
+	CpuDecoder(const CpuDecoder&) = delete;
+	CpuDecoder& operator=(const CpuDecoder&) = delete;
+
+	uint32_t getThreadCount() { return threadCount; }
+
+	// bytes of an nv12 frame slot, aligned
+	static uint64_t getSlotSize(uint32_t width, uint32_t height);
+
+	// opens the decoder and starts the worker, slot i is pSlots + i * getSlotSize(width, height)
+	void open(const std::vector<uint8_t>& parameterSets, uint32_t width, uint32_t height, uint8_t* pSlots, uint32_t slotCount);
+
+	// queues an annex-b access unit decoded into slot, returns the job sequence
+	// the data must stay valid until the job is decoded
+	uint64_t queue(uint32_t slot, const uint8_t* pData, uint32_t size);
+
+	// the slot holds the picture of the job, a broken frame counts as decoded and keeps the previous one
+	bool isDecoded(uint32_t slot, uint64_t sequence);
+
+	// drops queued jobs without waiting, they count as decoded and leave their slot as is
+	// the jobs sent meanwhile still complete, the next queued job should be an idr
+	void cancel();
+
+	// drops queued jobs and flushes the decoder, no slot is written after return
+	void flush();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifdef VM_CPU_DECODE
+
+#include <volk.h>
+#include <vector>
+
+#include "video_decoder.h"
+#include "cpu_decoder.h"
+
+class VulkanState;
+
+// cpu h264 decode backend for devices without a video decode queue
+// frames are decoded by a CpuDecoder into a staging slot per dpb slot and uploaded as nv12
+// into one image layer per dpb slot, sampled like the vulkan video dpb
+class CpuVideo : public VideoDecoder {
+private:
+	VulkanState* pVkState;
+
+	// bitstream, host memory
+	std::vector<uint8_t> bitStream;
+
+	CpuDecoder decoder;
+
+	// frame images, one layer per dpb slot
+	uint32_t width = 0;
+	uint32_t height = 0;
+	VkImage frameImage = VK_NULL_HANDLE;
+	VkDeviceMemory frameImageMemory = VK_NULL_HANDLE;
+	std::vector<VkImageView> frameImageViews;
+
+	// staging, one nv12 frame per dpb slot, written by the decoder
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	uint8_t* pStagingData = nullptr;
+	uint64_t slotStagingSize = 0;
+
+	// uploads, a command buffer and a fence per dpb slot, submitted without waiting
+	// a slot's staging is only rewritten by a decode queued after its upload fence signaled
+	std::vector<VkCommandBuffer> uploadCommandBuffers;
+	std::vector<VkFence> uploadFences;
+	std::vector<uint8_t> slotUploading;			// decode thread only
+	std::vector<uint64_t> slotUploadedSequence;	// decode thread only
+
+	void uploadSlot(uint32_t dpbSlot);
+	bool pollUpload(uint32_t dpbSlot);	// true once the slot has no upload in flight
+	void waitUploads();
+
+public:
+	CpuVideo(VulkanState* pVkState);
+	~CpuVideo();
+
+	const char* getName() override { return "CPU (libavcodec)"; }
+
+	uint64_t queryDecodeVideoCapabilities() override;
+	uint32_t clampDpbSlots(uint32_t dpbSlots) override;
+	uint32_t getDecodeLatency(Video* pVideo) override;
+
+	uint8_t* mapVideoStream(size_t dataStreamSize) override;
+	void unmapVideoStream() override;
+	void setupDecoder(Video* pVideo) override;
+
+	// queues the frame on the decoder, the result timeline value is the job sequence
+	void decodeFrame(Video* pVideo, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) override;
+
+	// submits the upload on the first call after the decoder wrote the frame, true once it executed
+	bool isDecoded(DecodeFrameResult* pResult) override;
+
+	// a layer of the upload image, sampled in the shader read layout
+	void getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) override;
+
+	// drops queued jobs, the decoder keeps running
+	void cancelDecodes() override;
+
+	// drops queued jobs, flushes the decoder and waits for the uploads
+	void waitIdle() override;
+};
+
+#endif
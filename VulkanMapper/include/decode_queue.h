@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "video_decoder.h"
+#include "decode_slots.h"
+#include "frame_table.h"
+
+// decodes of a video from their submit to their present, on the dpb slots of the video
+// queued decodes wait to be presented, in flight ones are tracked until they complete (references only included)
+// sized once from the slots, queueing, presenting and retiring allocate nothing
+class DecodeQueue {
+private:
+	DecodeSlots* pSlots;
+	VideoDecoder* pDecoder;
+
+	std::vector<DecodeFrameResult*> queued;		// submitted and not yet presented decodes, in decode order
+	std::vector<DecodeFrameResult*> inFlight;	// every submitted decode until it completes, in decode order
+	uint64_t decodeCount = 0;
+
+public:
+	// the slots are sized, both outlive the queue
+	DecodeQueue(DecodeSlots* pSlots, VideoDecoder* pDecoder);
+
+	// decodes frame into a free slot, queued for present when present is set, otherwise only a reference of later frames
+	// pVideo is handed to the backend, false when no slot is free or the backend is busy
+	bool queue(Video* pVideo, const FrameTable& frames, uint32_t frame, bool present, std::chrono::steady_clock::time_point deadline);
+
+	// drops the completed decodes from the in flight ones, their slots and bitstream can be reused
+	void retire();
+
+	// drops the queued decodes without waiting, in flight ones complete and stay tracked until retired
+	void flush();
+
+	// the queued decode of the frame shown at displayOrder, nullptr when there is none
+	DecodeFrameResult* find(const FrameTable& frames, uint32_t displayOrder);
+
+	// takes a queued decode out, its slot is no longer pending
+	void remove(DecodeFrameResult* pResult);
+
+	// first frame whose bitstream is still read by a decode, nextDecodeFrame when none is in flight
+	uint32_t getKeepFrame(uint32_t nextDecodeFrame) { return inFlight.empty() ? nextDecodeFrame : inFlight.front()->frame; }
+
+	const std::vector<DecodeFrameResult*>& getQueued() { return queued; }
+	uint32_t size() { return (uint32_t)queued.size(); }
+	bool empty() { return queued.empty(); }
+};
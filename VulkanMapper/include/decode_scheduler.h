@@ -0,0 +1,69 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+class VulkanState;
+
+// decode recorded by a video, waiting for the end of the tick
+struct DecodeSubmission {
+	VkCommandBuffer commandBuffer;
+	std::chrono::steady_clock::time_point deadline;	// presentation time of the video's next frame
+};
+
+struct DecodeSchedulerStats {
+	uint32_t lastBatchSize = 0;		// decodes in the last submit
+	uint64_t batchesSubmitted = 0;
+	uint64_t decodesSubmitted = 0;
+};
+
+// collects the decodes of all videos during a tick and submits them to the video queue at once,
+// completion of every decode is tracked on a single timeline semaphore, one value per batch
+// dpb layers stay in the dpb layout, graphics submits moving them out to sample or copy them
+// run between the decode batches: they wait for the submitted batches and the next batch waits for them
+class DecodeScheduler {
+private:
+	VulkanState* pVkState;
+
+	VkSemaphore decodeTimeline = VK_NULL_HANDLE;
+	uint64_t submittedValue = 0;	// value of the last submitted batch, written under the queue mutex
+	uint64_t completedValue = 0;	// read once per tick
+
+	VkSemaphore dpbAccessTimeline = VK_NULL_HANDLE;
+	uint64_t dpbAccessValue = 0;	// value of the last graphics submit moving dpb layers, under the queue mutex
+
+	std::vector<DecodeSubmission> submissions;
+	std::vector<VkCommandBuffer> batchCommandBuffers;
+
+	DecodeSchedulerStats stats;
+
+public:
+	DecodeScheduler(VulkanState* pVkState);
+	~DecodeScheduler();
+
+	// refreshes the completed value, call before the videos decode
+	void beginTick();
+
+	// adds a recorded decode to the batch, returns the timeline value signaled once decoded
+	uint64_t queueDecode(VkCommandBuffer commandBuffer, std::chrono::steady_clock::time_point deadline);
+
+	// submits the batch ordered by deadline, call after the videos decode
+	void submit();
+
+	uint64_t getCompletedValue() { return completedValue; }
+
+	// submits graphics work moving dpb layers out of the dpb layout and back, call with the queue mutex held
+	// submitInfo has no pNext and one binary semaphore at most to wait for and to signal
+	VkResult submitDpbAccess(VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence);
+
+	// blocks until the given value is reached, submits the batch first if it holds the value
+	void waitFor(uint64_t value);
+
+	// blocks until the oldest batch in flight completes or until passes,
+	// returns false at once when nothing is in flight
+	bool waitNext(std::chrono::steady_clock::time_point until);
+
+	const DecodeSchedulerStats& getStats() { return stats; }
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "video_decoder.h"
+
+// lifetime of a decoded picture buffer slot, the slot is free when all flags are cleared
+struct DpbSlot {
+	bool reference = false;		// short term reference of later decodes
+	bool decoding = false;		// written by a submitted decode that has not completed
+	bool pending = false;		// decoded or decoding, waiting to be presented
+	bool presented = false;		// currently shown
+	bool capturing = false;		// read by a frame cache copy batch still in flight
+
+	// picture held by the slot
+	uint32_t frame = 0;
+	int32_t poc = 0;
+	uint16_t frameNum = 0;
+	uint64_t decodeIndex = 0;	// sliding window order
+};
+
+// decoded picture buffer slots of a video, with the decode result of each
+// sized once, acquiring slots, tracking references and producing results allocate nothing
+class DecodeSlots {
+private:
+	std::vector<DpbSlot> slots;
+	std::vector<DecodeFrameResult> results;		// one per slot, the slot's last decode
+	std::vector<uint8_t> referencesPositions;	// active references, listed before each decode
+	uint32_t numReferenceFrames = 0;			// sliding window size
+
+public:
+	void resize(uint32_t slotsCount, uint32_t numReferenceFrames);
+	uint32_t size() { return (uint32_t)slots.size(); }
+	bool empty() { return slots.empty(); }
+
+	DpbSlot& operator[](int slot) { return slots[slot]; }
+	DecodeFrameResult* getResult(int slot) { return &results[slot]; }
+	const std::vector<uint8_t>& getReferencesPositions() { return referencesPositions; }
+
+	// a free slot, -1 when all are in use
+	int acquire();
+
+	// an idr drops all references
+	void resetReferences();
+	void listReferences();
+
+	// sliding window, the oldest reference is dropped when the window is full
+	void markReference(int slot);
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "draw_list.h"
+#include "vm_types.h"
+
+// consecutive draw packets sharing pipeline and material, recorded as one indirect draw
+struct DrawBatch {
+	PipelineId pipelineId;
+	int materialId;			// -1 for none
+	uint32_t firstCommand;
+	uint32_t commandCount;
+};
+
+// splits the packets, in draw order, into batches of neighbours sharing pipeline and material
+// the command of a packet is its index, batches is cleared first
+void batchPackets(const std::vector<DrawPacket>& packets, std::vector<DrawBatch>& batches);
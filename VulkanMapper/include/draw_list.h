@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "vm_types.h"
+
+class Object;
+
+// one draw of a scene object with the state it needs
+struct DrawPacket {
+	uint64_t key;			// layer, scene order
+	uint32_t objectIndex;	// scene order, indexes the geometry ranges
+	PipelineId pipelineId;
+	int materialId;			// -1 for none
+};
+
+// scene draws in stacking order, by layer then scene order, the order Scene::mouseRayCallback picks in reverse
+// neighbours sharing pipeline and material are batched, built once per frame and replayed by the viewport and the output
+class DrawList {
+private:
+	std::vector<DrawPacket> packets;
+	uint64_t sceneRevision = 0;
+	bool built = false;
+
+	// bind changes of the last build, when replayed in full
+	uint32_t pipelineChanges = 0;
+	uint32_t materialChanges = 0;
+
+public:
+	void build(const std::vector<Object*>& objects, uint64_t sceneRevision);
+
+	// false when objects were added or removed since the last build
+	bool isCurrent(uint64_t sceneRevision) { return built && DrawList::sceneRevision == sceneRevision; }
+
+	const std::vector<DrawPacket>& getPackets() { return packets; }
+	uint32_t getPipelineChanges() { return pipelineChanges; }
+	uint32_t getMaterialChanges() { return materialChanges; }
+};
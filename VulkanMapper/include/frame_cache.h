@@ -0,0 +1,122 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <functional>
+
+class VulkanState;
+
+// default memory budget of a video frame cache, 0 = disabled
+#define FRAME_CACHE_DEFAULT_BUDGET 0
+
+// cached frames per block, a block is one layered image bound to one allocation
+#define FRAME_CACHE_BLOCK_FRAMES 8
+
+// capture copies submitted and not yet done
+#define FRAME_CACHE_CAPTURES_IN_FLIGHT 4
+
+// decoded frames of a short loop kept as nv12 image layers, indexed by display order
+// a loop that fits the budget is captured while it plays once, then played from the cache without decoding
+class FrameCache {
+private:
+	VulkanState* pVkState;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t framesCount = 0;
+
+	struct CacheBlock {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		std::vector<VkImageView> views;			// one per layer
+		std::vector<uint32_t> layerFrames;		// display order of each layer, UINT32_MAX if free
+		uint32_t usedLayers = 0;
+	};
+
+	struct CachedFrame {
+		int32_t block = -1;
+		uint32_t layer = 0;
+		std::list<uint32_t>::iterator lruIt;
+	};
+
+	// emptied blocks are destroyed once the graphics queue is past their last use
+	struct RetiredBlock {
+		CacheBlock block;
+		VkFence fence = VK_NULL_HANDLE;		// null until the retire marker is submitted
+	};
+
+	std::vector<CacheBlock> blocks;			// entries without an image are free
+	std::vector<RetiredBlock> retiredBlocks;
+	uint32_t blockLayers = 0;
+	uint64_t blockBytes = 0;				// device memory of a block
+
+	std::vector<CachedFrame> cachedFrames;
+	std::list<uint32_t> lru;		// least recently presented first
+	uint32_t cachedCount = 0;
+
+	uint64_t budget = FRAME_CACHE_DEFAULT_BUDGET;
+	uint64_t usedBytes = 0;			// live blocks
+
+	// captures are copied on the graphics queue in batches, a ring of them in flight
+	struct Capture {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		uint64_t sequence = 0;
+		bool pending = false;
+	};
+
+	std::vector<Capture> captures;
+	uint32_t nextCapture = 0;
+	int32_t recordingCapture = -1;		// batch recorded and not yet submitted
+	bool recordingDpbCopies = false;	// the recorded batch moves dpb layers, submitted between the decodes
+	uint64_t captureSequence = 0;
+
+	void createBlock(CacheBlock& block);
+	void destroyBlock(CacheBlock& block);
+	void evict(uint32_t displayOrder);
+	void submitRetired();
+	void releaseRetired();
+
+public:
+	FrameCache(VulkanState* pVkState, uint32_t width, uint32_t height, uint32_t framesCount);
+	~FrameCache();
+
+	// evicts the blocks of the least recently presented frames above the budget
+	// blocks holding a frame isShown returns true for are kept
+	void setBudget(uint64_t budget, const std::function<bool(uint32_t)>& isShown);
+	uint64_t getBudget() { return budget; }
+	uint64_t getUsedBytes() { return usedBytes; }
+
+	// device memory needed to cache framesCount frames
+	uint64_t getBytesFor(uint32_t frames) { return (uint64_t)((frames + blockLayers - 1) / blockLayers) * blockBytes; }
+	uint64_t getRequiredBytes() { return getBytesFor(framesCount); }
+
+	// the whole loop fits the budget
+	bool fits() { return budget > 0 && getRequiredBytes() <= budget; }
+	bool isComplete() { return cachedCount == framesCount; }
+	bool contains(uint32_t displayOrder) { return cachedFrames[displayOrder].block >= 0; }
+
+	// no frame is cached and all the device memory is released
+	bool isReleased() { return usedBytes == 0 && retiredBlocks.empty(); }
+
+	// evicts the cached frames shouldEvict(displayOrder) returns true for
+	void evictWhere(const std::function<bool(uint32_t)>& shouldEvict);
+
+	// records the copy of a decoded frame, layer srcLayer of srcImage in srcLayout, into the cache
+	// returns false when the budget has no room for it, or the ring of batches has none yet (nothing blocks)
+	bool capture(uint32_t displayOrder, VkImage srcImage, uint32_t srcLayer, VkImageLayout srcLayout);
+
+	// submits the copies recorded since the last submit, returns the batch sequence
+	// copies out of dpb layers run after the decodes submitted so far, the next decodes run after them
+	uint64_t submitCaptures();
+
+	// the batch ran, the sources it copied can be overwritten
+	bool isCaptured(uint64_t sequence);
+
+	// returns the cached frame and marks it as recently presented
+	VkImageView use(uint32_t displayOrder);
+
+	// waits for the capture copies, their sources can be overwritten afterwards
+	void waitIdle();
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+enum FrameType {
+	IntraFrame = 0,			// full video frame
+	PredictiveFrame = 1,	// contain difference to otherframe
+};
+
+// slice header field flags
+#define FRAME_FIELD_PIC_FLAG 0x1
+#define FRAME_BOTTOM_FIELD_FLAG 0x2
+
+// per frame metadata, one array per field (structure of arrays)
+// holds only what decode, scheduling and seeking need
+struct FrameTable {
+	uint32_t count = 0;
+
+	// bitstream
+	std::vector<uint64_t> offset;			// offset in the bitstream buffer (ring relative when streaming)
+	std::vector<uint32_t> size;				// start code + nal of every slice
+	std::vector<uint32_t> firstSlice;		// index in the slice table
+	std::vector<uint16_t> sliceCount;
+
+	// timing, in track timescale ticks
+	std::vector<int64_t> timestamp;
+	std::vector<uint32_t> duration;
+
+	// picture
+	std::vector<uint8_t> type;				// FrameType
+	std::vector<uint8_t> referencePriority;	// nal_ref_idc
+	std::vector<int32_t> poc;
+	std::vector<int32_t> gop;
+	std::vector<int32_t> displayOrder;
+
+	// slice header
+	std::vector<uint16_t> frameNum;
+	std::vector<uint16_t> idrPicId;
+	std::vector<uint8_t> ppsId;
+	std::vector<uint8_t> fieldFlags;		// FRAME_FIELD_PIC_FLAG | FRAME_BOTTOM_FIELD_FLAG
+
+	// calls f(column) for every array, in a fixed order
+	template<typename F>
+	void forEachColumn(F f) {
+		f(offset);
+		f(size);
+		f(firstSlice);
+		f(sliceCount);
+		f(timestamp);
+		f(duration);
+		f(type);
+		f(referencePriority);
+		f(poc);
+		f(gop);
+		f(displayOrder);
+		f(frameNum);
+		f(idrPicId);
+		f(ppsId);
+		f(fieldFlags);
+	}
+
+	void resize(uint32_t count) {
+		FrameTable::count = count;
+		forEachColumn([count](auto& column) { column.resize(count); });
+	}
+
+	// bytes used by one frame across all columns
+	uint32_t getRowSize() {
+		uint32_t rowSize = 0;
+		forEachColumn([&rowSize](auto& column) { rowSize += sizeof(column[0]); });
+		return rowSize;
+	}
+};
+
+// slice nals of all frames, in decode order, a frame's slices are contiguous from its firstSlice
+struct SliceTable {
+	uint32_t count = 0;
+
+	std::vector<uint64_t> fileOffset;		// offset of the slice nal payload in the mp4 file
+	std::vector<uint32_t> size;				// start code + slice nal
+	std::vector<uint32_t> offset;			// from the start of the frame in the bitstream buffer
+
+	template<typename F>
+	void forEachColumn(F f) {
+		f(fileOffset);
+		f(size);
+		f(offset);
+	}
+
+	void resize(uint32_t count) {
+		SliceTable::count = count;
+		forEachColumn([count](auto& column) { column.resize(count); });
+	}
+
+	void push(uint64_t fileOffset, uint32_t size, uint32_t offset) {
+		SliceTable::fileOffset.push_back(fileOffset);
+		SliceTable::size.push_back(size);
+		SliceTable::offset.push_back(offset);
+		count++;
+	}
+
+	uint32_t getRowSize() {
+		uint32_t rowSize = 0;
+		forEachColumn([&rowSize](auto& column) { rowSize += sizeof(column[0]); });
+		return rowSize;
+	}
+};
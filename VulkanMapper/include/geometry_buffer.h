@@ -0,0 +1,90 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "vk_types.h"
+#include "vm_types.h"
+#include "range_allocator.h"
+
+class VulkanState;
+class Object;
+
+// where an object's geometry lives in the arena, indices are relative to firstVertex
+struct GeometryRange {
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+// growable arena of scene vertices and indices, every object owns a sub-allocation
+// the layout is shared by one persistently mapped region per frame in flight,
+// a region is rewritten only where objects changed since that frame last used it
+class GeometryBuffer {
+private:
+	VulkanState* pVkState;
+	uint32_t framesInFlight;
+
+	RangeAllocator vertexAllocator;
+	RangeAllocator indexAllocator;
+
+	// 16 bit until an object needs a larger index
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+	struct Slot {
+		GeometryRange range;
+		uint64_t revision = 0;					// object geometry revision the range was sized for
+		std::vector<uint64_t> regionRevisions;	// revision written in each region, 0 = never
+		uint64_t seenUpdate = 0;
+	};
+
+	std::unordered_map<ObjectId_t, Slot> slots;
+	uint64_t updatesCount = 0;
+	uint64_t sceneRevision = 0;			// scene objects last swept for
+
+	struct Region {
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+		Vertex* pVertices = nullptr;
+		uint32_t vertexCapacity = 0;
+
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+		void* pIndices = nullptr;
+		uint32_t indexCapacity = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	};
+
+	std::vector<Region> regions;
+	std::vector<GeometryRange> ranges;	// one per scene object, in scene order
+
+	// last update
+	uint64_t uploadedBytes = 0;
+	uint32_t rewrittenObjects = 0;
+	float updateSeconds = 0.0f;
+
+	// grows a region to the arena capacity and index type, keeping its content
+	void fitRegion(Region& region);
+	void allocate(Slot& slot, uint32_t vertexCount, uint32_t indexCount);
+	void free(Slot& slot);
+
+public:
+	GeometryBuffer(VulkanState* pVkState, uint32_t framesInFlight, uint32_t vertexCapacity, uint32_t indexCapacity);
+	~GeometryBuffer();
+
+	// the frame must not be in flight, sceneRevision changes when objects are added or removed
+	void update(const std::vector<Object*>& objects, uint64_t sceneRevision, uint32_t frame);
+
+	VkBuffer getVertexBuffer(uint32_t frame) { return regions[frame].vertexBuffer; }
+	VkBuffer getIndexBuffer(uint32_t frame) { return regions[frame].indexBuffer; }
+	VkIndexType getIndexType(uint32_t frame) { return regions[frame].indexType; }
+	const std::vector<GeometryRange>& getRanges() { return ranges; }
+
+	uint64_t getUploadedBytes() { return uploadedBytes; }
+	uint32_t getRewrittenObjects() { return rewrittenObjects; }
+	float getUpdateSeconds() { return updateSeconds; }
+	uint64_t getCapacityBytes();
+	uint64_t getUsedBytes();
+};
@@ -8,8 +8,17 @@ private:
 	VmTextureId_t textureId;
 	VulkanState* pDevice;
 
+	// decoded pixels, released after upload
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+
 public:
-	Image(MediaId_t id, VulkanState* pDevice, std::string filePath);
+	Image(MediaId_t id, VulkanState* pDevice, std::string filePath, MediaLoadProgress* pProgress = nullptr);
+
+	void upload() override;
+
+	VmTextureId_t getTextureId() { return textureId; }
 
 	~Image();
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <cstdint>
+#include "vk_types.h"
+#include "vm_types.h"
+#include "draw_batch.h"
+
+class VulkanState;
+class Object;
+class DrawList;
+class GeometryBuffer;
+
+// indexed indirect commands and per instance data of a renderer, one persistently mapped region per frame in flight
+// the command of a packet uses the packet index as first instance, the vertex shader reads its instance data with it
+class IndirectDraws {
+private:
+	VulkanState* pVkState;
+
+	struct Region {
+		VkBuffer commandBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory commandMemory = VK_NULL_HANDLE;
+		VkDrawIndexedIndirectCommand* pCommands = nullptr;
+
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+		InstanceData* pInstances = nullptr;
+
+		uint32_t capacity = 0;
+		VkDescriptorSet descriptorSet;	// renderer set 0 of the frame, the instance buffer is binding 1
+	};
+
+	std::vector<Region> regions;
+	std::vector<DrawBatch> batches;	// of the last update
+
+	// the commands are rewritten every update, a larger region doesn't keep its content
+	void fitRegion(Region& region, uint32_t count);
+	void destroyRegion(Region& region);
+
+public:
+	IndirectDraws(VulkanState* pVkState, const std::vector<VkDescriptorSet>& descriptorSets, uint32_t capacity);
+	~IndirectDraws();
+
+	// the frame must not be in flight, the geometry is updated for the same objects first
+	void update(const std::vector<Object*>& objects, DrawList* pDrawList, GeometryBuffer* pGeometry, uint32_t frame);
+
+	void record(VkCommandBuffer commandBuffer, const DrawBatch& batch, uint32_t frame);
+
+	const std::vector<DrawBatch>& getBatches() { return batches; }
+};
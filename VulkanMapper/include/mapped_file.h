@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// read-only memory mapping of a whole file
+// pages are loaded by the os on access, nothing is copied on open
+class MappedFile {
+private:
+	const uint8_t* pData = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+public:
+	MappedFile(const std::string& filePath);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const { return pData; }
+	size_t getSize() const { return size; }
+};
+
+// minimp4 read callback over a mapped file, token is the MappedFile
+// returns non zero when the range isn't fully inside the file
+int mappedFileRead(int64_t offset, void* buffer, size_t size, void* token);
+
+// process peak resident set size (high-water mark), in bytes
+uint64_t queryPeakResidentBytes();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// master clock ticks per second
+#define MASTER_CLOCK_TIMESCALE 1000000000ll
+
+// playback clock shared by all media, in 64 bit integer nanoseconds since its creation
+// media timestamps are rationals (ticks / track timescale) converted exactly, they don't drift apart
+class MasterClock {
+private:
+	std::chrono::steady_clock::time_point origin;
+
+public:
+	MasterClock();
+
+	int64_t now();
+	std::chrono::steady_clock::time_point toTimePoint(int64_t masterTime);
+};
+
+// floor(value * to / from), exact with a 128 bit product, the result must fit 64 bits
+int64_t rescaleTime(int64_t value, int64_t from, int64_t to);
@@ -2,6 +2,18 @@
 
 #include "vm_types.h"
 #include <string>
+#include <atomic>
+#include <cstdint>
+
+// loading progress, written by the loader thread and read by the ui
+struct MediaLoadProgress {
+	std::atomic<uint64_t> bytesParsed = 0;
+	std::atomic<uint64_t> bytesTotal = 0;
+	std::atomic<uint32_t> framesIndexed = 0;
+	std::atomic<uint32_t> framesCount = 0;
+	std::atomic<uint64_t> bytesUploaded = 0;
+	std::atomic<uint64_t> bytesToUpload = 0;
+};
 
 class Media {
 private:
@@ -16,6 +28,10 @@ public:
 
 	virtual ~Media() {};
 
+	// gpu work that has to run on the main thread,
+	// called once after loading and before the media is published
+	virtual void upload() {};
+
 	MediaId_t getId() const { return id; }
 	std::string getFilePath() { return filePath; }
 };
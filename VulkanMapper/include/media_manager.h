@@ -1,11 +1,25 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
 #include "vk_state.h"
 #include "video.h"
 #include "vm_types.h"
 #include "media.h"
 #include "app.h"
+#include "thread_pool.h"
+#include "master_clock.h"
+
+// longest the decode thread sleeps, bounds the delay of playback control changes
+// and of cpu decodes, which have nothing to block on
+#define DECODE_THREAD_MAX_WAIT_MS 2
+
+// videos handed between the main and the decode thread, at most one entry per media id
+#define VIDEO_HANDOFF_QUEUE_SIZE 256
 
 class Video;
 
@@ -13,25 +27,69 @@ class VulkanState;
 
 class App;
 
+// media being loaded on the loader pool
+struct PendingMedia {
+	MediaId_t id;
+	std::string filePath;
+	MediaLoadProgress progress;
+	std::future<Media*> result;
+};
+
 class MediaManager {
 private:
 	App* pApp;
-	std::vector<Media*> medias;
+	std::vector<Media*> medias;		// main thread only
 	MediaId_t newId();
 	std::vector<MediaId_t> toRemove;
+	std::vector<Video*> retiringVideos;	// removed and maybe still decoded, destroyed once the decode thread released them
+
+	ThreadPool* pLoadPool;
+	std::vector<PendingMedia*> pendingMedias;
+
+	MasterClock masterClock;	// shared by all videos
+
+	// decode runs on its own thread, blocking on the decode timeline between ticks,
+	// decoded frames reach the renderer through readyFrames
+	std::thread decodeThread;
+	std::atomic<bool> decodeRunning = false;
+	std::exception_ptr decodeError;
+	std::mutex mediaMutex;	// playback state of the videos, held by the decode thread while decoding, never while it blocks
+	ReadyFrameQueue readyFrames{ READY_FRAME_QUEUE_SIZE };
+
+	// the decode thread has its own list of videos, changed through the handoff queues
+	std::vector<Video*> decodeVideos;
+	SpscQueue<Video*> addedVideos{ VIDEO_HANDOFF_QUEUE_SIZE };		// main to decode thread
+	SpscQueue<Video*> removingVideos{ VIDEO_HANDOFF_QUEUE_SIZE };	// main to decode thread
+	SpscQueue<Video*> releasedVideos{ VIDEO_HANDOFF_QUEUE_SIZE };	// decode to main thread, no longer decoded
+	void handOffVideo(SpscQueue<Video*>& queue, Video* pVideo);
+	std::vector<ReadyFrame> newestFrames;	// reused by showReadyFrames
+	void decodeLoop();
+	void showReadyFrames();	// newest ready frame of each video to its frame stream
 
 public:
 	MediaManager(App* pApp);
 
+	// starts the decode thread, after the vulkan state init
+	void init();
+
+	// starts loading in background, the media is published by updateMedia once ready
 	void loadFile(std::string filePath);
 	
-	// video decode & remove ops
+	// publish loaded media, show decoded frames & remove ops
 	// intended to be used inside the main loop before rendering
 	void updateMedia();
 
+	// hold it to read or control video playback from the main thread while the decode thread runs
+	std::mutex& getMediaMutex() { return mediaMutex; }
+
+	const std::vector<PendingMedia*>& getPendingMedias() { return pendingMedias; }
+
 	std::vector<MediaId_t> getMediasIds();
 	Media* getMediaById(MediaId_t mediaId);
 	void removeMedia(MediaId_t mediaId);
 
+	// starts every video from the same master clock instant
+	void playAll();
+
 	void cleanup();
 };
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// first fit allocator of element ranges, free ranges are kept sorted and coalesced
+class RangeAllocator {
+private:
+	struct FreeRange {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	uint32_t capacity = 0;
+	uint32_t used = 0;
+	std::vector<FreeRange> freeRanges;	// by offset
+
+public:
+	RangeAllocator(uint32_t capacity = 0);
+
+	// returns false when no free range is large enough, empty ranges always succeed
+	bool allocate(uint32_t count, uint32_t& offset);
+	void free(uint32_t offset, uint32_t count);
+
+	// appends the space between the current and the new capacity
+	void grow(uint32_t capacity);
+
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getUsed() const { return used; }
+};
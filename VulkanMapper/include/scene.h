@@ -6,6 +6,7 @@
 #include <memory>
 #include "scene_objects.h"
 #include "app.h"
+#include "vm_types.h"
 
 class Object;
 
@@ -20,6 +21,8 @@ private:
 	float lastDraggingY = 0.0f;
 
 	std::vector<Object*> pObjects;
+	ObjectId_t nextObjectId = 0;	// ids are never reused
+	uint64_t revision = 0;			// changes when objects are added or removed
 
 	App* pApp;
 
@@ -30,10 +33,12 @@ public:
 	int getHoveringObjectId() { return hoveringObjId; };
 	int getDragginObjectId() { return draggingObjId; };
 
-	uint8_t addObject(Object* pObject);
-	void removeObject(uint8_t objectId);
-	Object* getObjectPointer(uint8_t objectId);
-	std::vector<uint8_t> getIds();
+	ObjectId_t addObject(Object* pObject);
+	void removeObject(ObjectId_t objectId);
+	Object* getObjectPointer(ObjectId_t objectId);
+	std::vector<ObjectId_t> getIds();
+	const std::vector<Object*>& getObjects() { return pObjects; };	// in draw order
+	uint64_t getRevision() { return revision; };
 	double triangleArea(glm::vec2 a, glm::vec2 b, glm::vec2 c);
 	bool pointInsideTriangle(glm::vec2 point, std::vector<glm::vec2> triangle);
 	void mouseRayCallback(glm::vec4 mouseRay);
@@ -16,19 +16,35 @@ class App;
 
 class Object {
 private:
-	uint8_t id;
+	ObjectId_t id;
+	uint64_t geometryRevision = nextGeometryRevision();
+
+	// unique across objects, a new object never matches geometry written for a removed one
+	static uint64_t nextGeometryRevision() {
+		static uint64_t revision = 0;
+		return ++revision;
+	}
+
+protected:
+	// call when getVertices() or getIndices() changes, renderers rewrite the object geometry
+	void geometryChanged() { geometryRevision = nextGeometryRevision(); }
 
 public:
-	uint8_t getId() { return Object::id; };
-	void setId(uint8_t id) {
+	ObjectId_t getId() { return Object::id; };
+	void setId(ObjectId_t id) {
 		Object::id = id;
 	}
 	virtual void beforeRemove() = 0;
 
 	// renderer
+	uint64_t getGeometryRevision() { return geometryRevision; }
 	virtual std::vector<Vertex> getVertices() = 0;
-	virtual std::vector<uint16_t> getIndices() = 0;
-	virtual std::string getPipelineName() = 0;
+	virtual std::vector<uint32_t> getIndices() = 0;	// relative to the object vertices
+	virtual PipelineId getPipelineId() = 0;
+	virtual int getMaterialId() { return -1; };	// media bound per draw batch, -1 for none
+	virtual uint32_t getTextureIndex() { return 0; };	// element of the texture array sampled by the texture pipeline
+	virtual uint8_t getDrawLayer() { return 0; };	// drawn over lower layers, draw sorting never crosses layers
+	virtual glm::vec3 getTint() { return glm::vec3(0.0f); };	// added to the vertex color per draw, changes don't touch the geometry
 
 	// events
 	virtual void hoveringStart() = 0;
@@ -47,11 +63,14 @@ private:
 	float pos_x = 0;
 	float pos_y = 0;
 	std::vector<Vertex> vertices;
-	std::vector<uint8_t> markerIds;
-	std::vector<uint8_t> lineIds;
+	std::vector<ObjectId_t> markerIds;
+	std::vector<ObjectId_t> lineIds;
 	float width;
 	float height;
 	int mediaId = -1;	// -1 for unset
+	PipelineId pipelineId = ColorPipeline;	// resolved when the media is set
+	uint32_t textureIndex = 0;
+	bool selected = false;
 
 public:
 	Plane(App* pApp, Scene* scene_ptr, float width, float height, float pos_x, float pos_y);
@@ -61,8 +80,11 @@ public:
 	void beforeRemove();
 
 	std::vector<Vertex> getVertices();
-	std::vector<uint16_t> getIndices();
-	std::string getPipelineName();
+	std::vector<uint32_t> getIndices();
+	PipelineId getPipelineId() { return pipelineId; };
+	int getMaterialId() { return pipelineId == VideoFramePipeline ? mediaId : -1; };	// textures don't split batches
+	uint32_t getTextureIndex() { return textureIndex; };
+	glm::vec3 getTint() { return selected ? glm::vec3(.1f) : glm::vec3(0.0f); };
 
 	MediaId_t getMediaId() {
 		return Plane::mediaId;
@@ -87,19 +109,21 @@ private:
 	float pos_y;
 	bool highlighted = false;
 	glm::vec3 color;
-	uint8_t parent_id;
+	ObjectId_t parent_id;
 	uint16_t vertex_id;
 
 public:
-	Marker(Scene* scene_ptr, float pos_x, float pos_y, glm::vec3 color, uint8_t parent_id, uint16_t vertex_id);
+	Marker(Scene* scene_ptr, float pos_x, float pos_y, glm::vec3 color, ObjectId_t parent_id, uint16_t vertex_id);
 	
 	Scene* scene_ptr;
 
 	void beforeRemove() { return; };
 
 	std::vector<Vertex> getVertices();
-	std::vector<uint16_t> getIndices();
-	std::string getPipelineName() { return "color"; };
+	std::vector<uint32_t> getIndices();
+	PipelineId getPipelineId() { return ColorPipeline; };
+	uint8_t getDrawLayer() { return 2; };
+	glm::vec3 getTint() { return highlighted ? glm::vec3(.2f) : glm::vec3(0.0f); };
 
 	void hoveringStart();
 	void hoveringStop();
@@ -120,8 +144,9 @@ public:
 
 	// renderer
 	std::vector<Vertex> getVertices();
-	std::vector<uint16_t> getIndices();
-	std::string getPipelineName() { return "line"; };
+	std::vector<uint32_t> getIndices();
+	PipelineId getPipelineId() { return LinePipeline; };
+	uint8_t getDrawLayer() { return 1; };
 
 	void beforeRemove() { return; };
 
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "frame_table.h"
+#include "thread_pool.h"
+
+// parses the slice headers of an indexed track, fills the slice header columns, poc and gop of every frame
+// fileData is the mp4 the slice table points into, spsData and ppsData hold the parsed h264::SPS and h264::PPS arrays
+// the track is split at idr frames and the gops are parsed in parallel on pParsePool when given,
+// the result doesn't depend on it
+void parseSliceHeaders(FrameTable& frames, const SliceTable& slices, const uint8_t* fileData,
+	const std::vector<uint8_t>& spsData, const std::vector<uint8_t>& ppsData,
+	ThreadPool* pParsePool = nullptr, std::atomic<uint32_t>* pFramesIndexed = nullptr);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// bounded lock-free queue between one producer and one consumer thread
+// the capacity is rounded up to a power of two
+template<typename T>
+class SpscQueue {
+private:
+	std::vector<T> items;
+	uint64_t mask = 0;
+
+	// each index is written by one side only, kept on separate cache lines
+	alignas(64) std::atomic<uint64_t> head = 0;	// next item to pop, consumer side
+	alignas(64) std::atomic<uint64_t> tail = 0;	// next item to push, producer side
+
+public:
+	SpscQueue(uint32_t capacity) {
+		uint64_t size = 1;
+		while (size < capacity) size <<= 1;
+
+		items.resize(size);
+		mask = size - 1;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// producer, returns false when full
+	bool push(const T& item) {
+		uint64_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) > mask) return false;
+
+		items[currentTail & mask] = item;
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer, returns false when empty
+	bool pop(T& item) {
+		uint64_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire)) return false;
+
+		item = items[currentHead & mask];
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+
+// fixed size pool of worker threads running queued tasks
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+
+	std::mutex tasksMutex;
+	std::condition_variable tasksCondition;
+	bool stopping = false;
+
+	void workerLoop();
+
+public:
+	// threadCount = 0 uses all hardware threads
+	ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t getThreadCount() const { return (uint32_t)workers.size(); }
+
+	// queue a task, the returned future holds its result or exception
+	template<typename F>
+	auto submit(F task) -> std::future<decltype(task())> {
+		using Result = decltype(task());
+
+		auto pTask = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		std::future<Result> result = pTask->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(tasksMutex);
+			tasks.push([pTask]() { (*pTask)(); });
+		}
+		tasksCondition.notify_one();
+
+		return result;
+	}
+
+	// runs task(i) for i in [0, count) on the pool and the calling thread, returns when all are done
+	// the caller takes part, so it's safe to call from a pool task
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+};
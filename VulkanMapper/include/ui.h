@@ -1,11 +1,25 @@
 #pragma once
 
+#include <vector>
 #include "scene.h"
 #include "media_manager.h"
 #include "vm_types.h"
 #include <GLFW/glfw3.h>
 #include "app.h"
 
+// stress test, planes added at once then churned for a number of frames
+#define STRESS_PLANES_COUNT 10000
+#define STRESS_FRAMES 120
+#define STRESS_CHURN_PLANES 100		// removed and added again every frame
+
+// scene update time per frame of the last stress test
+struct StressStats {
+	float addFrameMs = 0.0f;		// frame after all the planes were added
+	float averageFrameMs = 0.0f;	// churn frames
+	float maxFrameMs = 0.0f;
+	uint32_t frames = 0;
+};
+
 class Scene;
 
 class MediaManager;
@@ -29,6 +43,16 @@ private:
 	void deselectMedia();
 
 	void planesMenu();
+
+	// the stress test runs one step per frame, the scene update of each step is timed by the next frame
+	std::vector<ObjectId_t> stressPlanes;	// oldest first
+	uint32_t stressFrame = 0;
+	bool stressRunning = false;
+	uint32_t stressNextPlane = 0;
+	float stressTotalMs = 0.0f;
+	StressStats stressStats;
+	ObjectId_t addStressPlane();
+	void stressStep();
 	void drawTopBar();
 	void drawMediaManager();
 	void drawPropertiesManager();
@@ -3,11 +3,49 @@
 #include <vector>
 #include <chrono>
 #include <string>
+#include <atomic>
 
 #include "vk_video.h"
+#include "video_decoder.h"
 #include "vk_state.h"
 #include "vm_types.h"
 #include "media.h"
+#include "mapped_file.h"
+#include "bitstream_ring.h"
+#include "thread_pool.h"
+#include "frame_table.h"
+#include "decode_slots.h"
+#include "decode_queue.h"
+#include "frame_cache.h"
+#include "master_clock.h"
+#include "spsc_queue.h"
+
+// upper bound of bitstream memory per video, longer tracks are streamed through a ring
+#define STREAM_RING_SIZE (64ull * 1024 * 1024)
+
+// decodes in flight on the video queue per video
+#define DECODE_AHEAD_DEPTH 3
+#define MAX_DECODE_AHEAD_DEPTH 8
+
+// frames of the next loop iteration decoded while the tail of the current one plays,
+// in dpb slots reserved next to the decode ahead ones
+#define LOOP_PREROLL_DEPTH 4
+
+// playback rate magnitude, negative rates play backwards
+#define MIN_PLAYBACK_RATE 0.25f
+#define MAX_PLAYBACK_RATE 4.0f
+
+// playback rate resolution, the rate is the rational playbackRate * PLAYBACK_RATE_DENOMINATOR / PLAYBACK_RATE_DENOMINATOR
+#define PLAYBACK_RATE_DENOMINATOR 1000
+
+// above this rate frames nothing references are not decoded (nor shown)
+#define SKIP_NON_REFERENCE_RATE 2.0f
+
+// frames shown per reverse window, decoded forward from their keyframe into a frame pool
+#define REVERSE_WINDOW_FRAMES 32
+
+// frames handed from the decode thread to the renderer and not yet shown, for all videos
+#define READY_FRAME_QUEUE_SIZE 256
 
 class VulkanVideo;
 
@@ -15,28 +53,143 @@ struct DecodeFrameResult;
 
 class VulkanState;
 
-enum FrameType {
-	IntraFrame = 0,			// full video frame
-	PredictiveFrame = 1,	// contain difference to otherframe
+
+// memory cost of loading a video, used to track the ingest path
+struct IngestStats {
+	uint64_t bytesCopied = 0;			// bytes written by the cpu while loading
+	uint64_t peakResidentBefore = 0;	// process peak rss before loading
+	uint64_t peakResidentAfter = 0;		// process peak rss after loading
+};
+
+// decoder throughput, measured over one second windows
+struct DecodeThroughput {
+	float decodesPerSecond = 0.0f;
+	float sustainableRate = MAX_PLAYBACK_RATE;	// fastest rate the decoder was seen to keep up with
+	bool saturated = false;						// a due frame was still decoding in the last window
+};
+
+// presentation timing against the master clock
+struct VideoClockStats {
+	int64_t driftNs = 0;			// lateness of the last shown frame
+	int64_t maxDriftNs = 0;
+	uint64_t droppedFrames = 0;		// late frames skipped for a newer decoded one
 };
 
-struct FrameInfo {
-	uint64_t offset = 0;
-	uint64_t size = 0;
-	float timestampSeconds = 0;
-	float durationSeconds = 0;
-	FrameType type = FrameType::IntraFrame;
-	uint32_t referencePriority = 0;
-	int poc = 0;
-	int gop = 0;
-	int displayOrder = 0;
+// frame published by the decode thread, shown by the main thread on the video frame stream
+struct ReadyFrame {
+	MediaId_t mediaId;
+	VmVideoFrameStreamId_t streamId;
+	VmVideoFrame frame;
+	uint64_t sequence;		// per video, increasing
 };
 
+typedef SpscQueue<ReadyFrame> ReadyFrameQueue;
+
 class Video : public Media {
 private:
 	VulkanState* pDevice;
+	MasterClock* pMasterClock;
 	VmVideoFrameStreamId_t vmVideoFrameStreamId;
 	bool presentAFrame = true; // emit first frame anyways
+	bool decodeVisible = true;	// visibility the decode thread last acted on
+
+	// frames handed to the renderer, a published frame stays valid until the renderer shows a newer one
+	struct PublishedFrame {
+		uint64_t sequence;
+		int dpbSlot;			// -1 for frames from a frame pool
+		uint32_t displayOrder;
+	};
+	ReadyFrameQueue* pReadyFrames;
+	std::vector<PublishedFrame> publishedFrames;	// oldest first, the front one may still be drawn
+	uint64_t publishedSequence = 0;
+	std::atomic<uint64_t> shownSequence = 0;		// written by the main thread
+	bool publishFrame(const VmVideoFrame& frame, int dpbSlot);	// false when the queue is full, the frame is dropped
+	void retirePublishedFrames();
+	bool isPublished(uint32_t displayOrder);
+
+	// bitstream source
+	MappedFile* pFile = nullptr;
+	uint8_t* pStreamData = nullptr;
+	BitstreamRing* pStreamRing = nullptr;
+	uint32_t nextStreamFrame = 0;
+	uint64_t bitStreamAlignment = 1;
+
+	void parseTrack(MediaLoadProgress* pProgress, ThreadPool* pParsePool);
+	uint64_t writeFrame(uint32_t frame, uint8_t* dstBuffer);
+	bool prepareStream();	// returns true when the next frame to decode is resident
+
+	// keyframe index, seeks decode from the closest idr before the target
+	std::vector<uint32_t> keyFrames;			// decode order of the idr frames
+	std::vector<uint32_t> displayToDecodeOrder;
+	void buildKeyFrameIndex();
+
+	// seek in progress, frames shown before the target are decoded only when referenced
+	int64_t seekTargetOrder = -1;
+	bool seekPending = false;
+	std::chrono::steady_clock::time_point seekStartTime;
+	bool seekKeepsClock = false;	// the seek continues on the running clock, the anchor is kept
+	void finishSeek();
+	void seekToClock();		// seeks to the frame at the current media time
+
+	// decode ahead, reordered to display order on present
+	DecodeQueue* pDecodeQueue = nullptr;		// on the dpb slots, created with them
+	uint32_t nextPresentOrder = 0;				// display order of the next frame to present
+
+	void flushDecodeQueue();
+	void resetClock();	// times the next frame to present from now
+	uint32_t getDecodeQueueTarget();
+	bool queueDecode(std::chrono::steady_clock::time_point deadline, bool present);	// false when the ring or the dpb is full
+	bool isReached(uint32_t displayOrder);	// the clock passed the frame timestamp
+	bool isDue();		// the next frame in display order should be shown
+	void advancePresent();
+	void stepPresentOrder();	// next frame in playback direction, looping
+	void skipLateFrames(FrameCache* pPool);
+
+	// media clock, track ticks run at the playback rate from an anchor on the master clock
+	int64_t anchorMasterTime = 0;
+	int64_t anchorMediaTime = 0;
+	int64_t rateNumerator = PLAYBACK_RATE_DENOMINATOR;
+	int64_t getMediaTime();
+	int64_t toMasterTime(int64_t mediaTime);	// master time the clock reaches mediaTime
+	std::chrono::steady_clock::time_point getDeadline();
+	void measureDrift();
+
+	// frames not decoded at high rates, by display order, stepped over on present
+	std::vector<uint8_t> skippedFrames;
+	void dropSkippedFrames();
+
+	// reverse playback, windows of frames are decoded forward into a pool and shown backwards
+	FrameCache* pReverseWindow = nullptr;
+	int64_t reverseWindowLow = -1;		// display order range of the window being decoded, -1 = none
+	uint32_t reverseWindowHigh = 0;
+	uint32_t reverseWindowEnd = 0;		// decode order after the last frame of the window
+	void startReverseWindow(uint32_t high);
+	void decodeReverse();
+
+	// throughput accounting
+	std::chrono::steady_clock::time_point throughputWindowStart = std::chrono::high_resolution_clock::now();
+	uint32_t windowDecodes = 0;
+	uint32_t windowFramesAdvanced = 0;	// shown or skipped
+	bool windowSaturated = false;
+	void updateThroughput();
+	void applyPlaybackRate(float rate);
+
+	// short loops played from decoded frames once cached, the cache exists only with a budget
+	FrameCache* pFrameCache = nullptr;
+	uint64_t frameCacheBudget = FRAME_CACHE_DEFAULT_BUDGET;
+	bool playingFromCache = false;
+	void presentFromCache();
+	void releaseFrameCache();
+
+	// dpb slots copied into the frame cache or the reverse pool, released once their copy batch ran
+	struct SlotCapture {
+		FrameCache* pCache;
+		int dpbSlot;
+		uint64_t captureSequence;		// copy batch reading the slot
+	};
+	std::vector<SlotCapture> slotCaptures;
+	void releaseCapturedSlots();
+	bool isCapturing(FrameCache* pCache);
 
 public:
 	uint32_t width = 0;
@@ -44,7 +197,17 @@ public:
 	uint32_t bitRate = 0;
 	float averageFrameRate = 0.0f;
 	float durationSeconds = 0.0f;
+	uint32_t timescale = 1;		// track ticks per second
+	int64_t durationTicks = 0;
 	uint64_t bitStreamSize = 0;
+	uint64_t maxFrameSize = 0;	// aligned
+	uint64_t maxGopSize = 0;	// aligned
+
+	// bitstream buffer
+	bool streaming = false;
+	uint64_t streamBufferSize = 0;
+
+	IngestStats ingestStats;
 
 	// sequence parameter set
 	std::vector<uint8_t> spsData;
@@ -54,34 +217,73 @@ public:
 	std::vector<uint8_t> ppsData;
 	uint32_t ppsCount = 0;
 
-	// frame slice header data
-	std::vector<uint8_t> frameSliceHeaderData;
-
-	std::vector<FrameInfo> frameInfos;
+	// frame metadata
+	FrameTable frames;
+	SliceTable slices;
 
-	VulkanVideo* pVkDecoder = nullptr;
+	VideoDecoder* pDecoder = nullptr;	// vulkan video, or the cpu backend without a video queue
+	uint32_t decodeLatency = 0;
 	// decoded picture buffer
 	uint32_t numDpbSlots = 0;
+	uint32_t numReferenceFrames = 0;	// sliding window size (sps num_ref_frames)
+	DecodeSlots dpbSlots;			// with the result of their last decode
+	uint32_t nextDecodeFrame = 0;
+	uint32_t decodeAheadDepth = DECODE_AHEAD_DEPTH;	// 1 to MAX_DECODE_AHEAD_DEPTH
 
-	std::chrono::steady_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+	// parses the track and fills the bitstream buffer, safe to run on a loader thread
+	// gops are parsed in parallel on pParsePool when given
+	// ready frames are published to pReadyFrames, the queue is shared by the videos of the decode thread
+	Video(MediaId_t id, VulkanState* pDevice, MasterClock* pMasterClock, ReadyFrameQueue* pReadyFrames, std::string filePath, MediaLoadProgress* pProgress = nullptr, ThreadPool* pParsePool = nullptr);
 
-	std::vector<uint8_t> referencesPositions;
-	uint8_t currentDecodePosition = 0;
-	uint8_t nextDecodePosition = 0;
+	// creates the decoder, the first frame is decoded by the next decodeFrame
+	void upload() override;
 
-	Video(MediaId_t id, VulkanState* pDevice, std::string filePath);
-
-	uint64_t currentFrame = 0;
+	uint64_t currentFrame = 0;	// display order of the last presented frame
 	uint32_t framesCount = 0;
 	
+	// publishes the due frame and keeps the decode queue filled, runs on the decode thread
 	void decodeFrame();
-	DecodeFrameResult* decodingResult = nullptr;
+	std::chrono::steady_clock::time_point getNextDeadline();	// presentation time of the next frame, max when paused
+
+	// the renderer shows the published frame sequence, older frames can be reused
+	void setShownSequence(uint64_t sequence) { shownSequence.store(sequence, std::memory_order_release); }
+	uint32_t getDecodesInFlight() { return pDecodeQueue->size(); }
+	uint32_t getPrerolledFrames();	// queued frames of the next loop iteration
+
+	// frame cache memory budget in bytes, 0 disables it, cached frames above it are evicted
+	void setFrameCacheBudget(uint64_t budget);
+	uint64_t getFrameCacheBudget() { return frameCacheBudget; }
+	FrameCache* getFrameCache() { return pFrameCache; }
+	bool isPlayingFromCache() { return playingFromCache; }
 
 	bool playing = false;	// default: not playing
+	float playbackRate = 1.0f;
+	void setPlaybackRate(float rate);	// magnitude clamped to MIN_PLAYBACK_RATE..MAX_PLAYBACK_RATE
+
+	DecodeThroughput throughput;
+	bool limitRateToDecoder = false;	// lowers the playback rate to what the decoder sustains
+
+	VideoClockStats clockStats;
+
+	// starts playback with the clock anchored at masterTime, videos started at the same time stay in sync
+	void playAt(int64_t masterTime);
 	void pause();
 	void play();
 	void firstFrame();
 
+	// shows the frame displayed at time (seconds from the start), decoding from the previous keyframe
+	void seek(float time);
+	void seekFrame(uint32_t displayOrder);
+	float lastSeekLatencySeconds = 0.0f;	// from the seek call to the target frame shown
+
+	// visibility, set every frame by the main thread from the planes sampling the video, without the media lock
+	std::atomic<bool> visible = true;
+	void setVisible(bool visible);
+	void updateVisibility();	// applies a change on the decode thread, before isIdle
+
+	// nothing to present, decodeFrame can be skipped, the last frame stays shown
+	bool isIdle() { return !decodeVisible || (!playing && !presentAFrame); }
+
 	VmVideoFrameStreamId_t getVmVideoFrameStreamId() {
 		return vmVideoFrameStreamId;
 	}
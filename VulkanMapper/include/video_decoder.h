@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+class Video;
+
+struct VmVideoFrame;
+
+// no graphics api types, the decode queue is built and tested without them
+struct DecodeFrameResult {
+	uint64_t timelineValue;		// completion value of the decode, backend defined
+	uint32_t frame;
+	uint32_t dpbSlot;
+};
+
+// h264 decode backend of a video
+// decoded frames land in the dpb slot chosen by the video, one image view per slot
+class VideoDecoder {
+public:
+	virtual ~VideoDecoder() {}
+
+	virtual const char* getName() = 0;
+
+	// returns the bitstream alignment
+	virtual uint64_t queryDecodeVideoCapabilities() = 0;
+
+	// clamps the requested dpb slots to the backend limits, valid after queryDecodeVideoCapabilities
+	virtual uint32_t clampDpbSlots(uint32_t dpbSlots) = 0;
+
+	// frames the backend holds back before a decode completes, the video decodes this far ahead
+	virtual uint32_t getDecodeLatency(Video* pVideo) { return 0; }
+
+	// returns the bitstream buffer mapped,
+	// the caller writes the annex-b stream directly into it
+	virtual uint8_t* mapVideoStream(size_t dataStreamSize) = 0;
+	virtual void unmapVideoStream() = 0;
+
+	virtual void setupDecoder(Video* pVideo) = 0;
+
+	// false while the backend has no room for another decode, decodeFrame never blocks on one
+	virtual bool canDecode() { return true; }
+
+	// decodes pResult->frame into the slot pResult->dpbSlot and sets the completion value,
+	// pResult is owned by the video (one per dpb slot), nothing is allocated per frame
+	virtual void decodeFrame(Video* pVideo, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) = 0;
+	virtual bool isDecoded(DecodeFrameResult* pResult) = 0;
+
+	// picture of a dpb slot, an image layer and the layout it stays in between uses (dpb layers stay in the dpb layout)
+	virtual void getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) = 0;
+
+	// drops the decodes not started yet without blocking, they still report decoded (slot left as is)
+	virtual void cancelDecodes() {}
+
+	// after return no queued decode writes to a dpb slot, blocks
+	virtual void waitIdle() = 0;
+};
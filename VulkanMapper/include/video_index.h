@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// sidecar cache of the parsed frame index, stored next to the media file
+// keyed by media path, size and modification time
+#define VIDEO_INDEX_EXTENSION ".vmidx"
+#define VIDEO_INDEX_MAGIC 0x58444d56	// "VMDX"
+#define VIDEO_INDEX_VERSION 4
+
+class Video;
+
+// fills the video track info from the sidecar index,
+// returns false when the index is missing, stale or incompatible
+bool loadVideoIndex(Video* pVideo, uint64_t bitStreamAlignment);
+
+// writes the sidecar index of a parsed video, failures are not fatal
+void saveVideoIndex(Video* pVideo, uint64_t bitStreamAlignment);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <volk.h>
+#include <vector>
+#include <cstdint>
+
+class VulkanState;
+
+// released sessions kept for reuse, the oldest is destroyed past it
+#define VIDEO_SESSION_POOL_SIZE 4
+
+// dpb slot counts are rounded up to it, clips with close reference counts share sessions
+#define VIDEO_SESSION_DPB_SLOT_GRANULARITY 4
+
+// what a session and its dpb are created for, videos with equal keys can swap them
+struct VideoSessionKey {
+	uint32_t profileIdc = 0;		// StdVideoH264ProfileIdc
+	uint32_t width = 0;				// coded extent
+	uint32_t height = 0;
+	uint32_t dpbSlots = 0;
+
+	bool operator==(const VideoSessionKey& other) const {
+		return profileIdc == other.profileIdc && width == other.width && height == other.height && dpbSlots == other.dpbSlots;
+	}
+};
+
+// video session, its bound memory and the dpb image array backing its slots
+struct PooledVideoSession {
+	VideoSessionKey key;
+
+	VkVideoSessionKHR videoSession = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> videoSessionMemories;
+
+	VkImage dpbImage = VK_NULL_HANDLE;	// multi layer
+	VkDeviceMemory dpbImageMemory = VK_NULL_HANDLE;
+	VkImageView dpbImageView = VK_NULL_HANDLE;
+	std::vector<VkImageView> decodedImageViews;
+};
+
+struct VideoSessionPoolStats {
+	uint64_t created = 0;
+	uint64_t reused = 0;
+	uint32_t free = 0;
+};
+
+// recycles video sessions and dpbs of removed videos,
+// a clip of an already seen format starts without session creation and memory binding
+class VideoSessionPool {
+private:
+	VulkanState* pVkState;
+	std::vector<PooledVideoSession*> freeSessions;	// oldest first
+	VideoSessionPoolStats stats;
+
+	PooledVideoSession* createSession(const VideoSessionKey& key, const VkVideoProfileInfoKHR* pVideoProfile, const VkVideoCapabilitiesKHR& videoCapabilities);
+	void destroySession(PooledVideoSession* pSession);
+
+public:
+	VideoSessionPool(VulkanState* pVkState);
+	~VideoSessionPool();
+
+	// returns a free session with the same key or creates one
+	PooledVideoSession* acquire(const VideoSessionKey& key, const VkVideoProfileInfoKHR* pVideoProfile, const VkVideoCapabilitiesKHR& videoCapabilities);
+
+	// the session must be idle, it must be reset before its next decode
+	void release(PooledVideoSession* pSession);
+
+	VideoSessionPoolStats getStats() { return stats; }
+};
@@ -10,6 +10,9 @@
 
 #include <vector>
 #include "app.h"
+#include "geometry_buffer.h"
+#include "draw_list.h"
+#include "indirect_draws.h"
 
 struct Pipeline;
 
@@ -54,6 +57,7 @@ private:
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
 	uint32_t currentFrame = 0;
+	bool samplesDpb = false;	// the recorded command buffer moves dpb layers, submitted after the decodes
 
 	// command pool
 	VkCommandPool commandPool;
@@ -61,7 +65,7 @@ private:
 
 	// rendering
 	VkRenderPass renderPass;
-	std::map<std::string, Pipeline> pipelines;
+	std::vector<Pipeline> pipelines;	// by PipelineId
 	std::vector<VkFramebuffer> frameBuffers;
 
 	// uniform buffer for output mvp matrix
@@ -71,6 +75,11 @@ private:
 	VkDescriptorPool descriptorPool;
 	std::vector<VkDescriptorSet> uniformBufferSets;
 
+	// scene geometry, separate from the viewport since output frames are fenced separately
+	GeometryBuffer* pGeometry = nullptr;
+	DrawList* pDrawList = nullptr;	// owned by the vulkan state
+	IndirectDraws* pIndirectDraws = nullptr;
+
 	static void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 	void initWindow(GLFWmonitor* monitor);
@@ -14,6 +14,7 @@
 #include <optional>
 #include <string>
 #include <map>
+#include <mutex>
 #include "scene.h"
 #include "ui.h"
 #include "media_manager.h"
@@ -21,6 +22,11 @@
 #include "vk_utils.h"
 #include "vm_types.h"
 #include "app.h"
+#include "decode_scheduler.h"
+#include "video_session_pool.h"
+#include "geometry_buffer.h"
+#include "draw_list.h"
+#include "indirect_draws.h"
 
 struct PipelineToLoad {
     std::string name;
@@ -30,14 +36,14 @@ struct PipelineToLoad {
     std::vector<VkDescriptorSetLayout*> descriptorSetLayouts;
 };
 
-typedef uint8_t VmTextureId_t;
+typedef uint32_t VmTextureId_t;     // element of the texture array
 
 struct VmTexture{
     VmTextureId_t id;
     VkImage image;
     VkDeviceMemory imageMemory;
     VkImageView imageView;
-    VkDescriptorSet descriptorSet;
+    VkDescriptorSet descriptorSet;      // viewport surfaces, shown by imgui
     uint32_t width;
     uint32_t height;
 };
@@ -47,19 +53,20 @@ struct Pipeline {
     VkPipelineLayout pipelineLayout;
 };
 
-// video frames sync elements for rendering
+// decoded frame, one layer of a video image
+// frames held in another layout (dpb layers) are moved to the shader read layout around the draws sampling them
+struct VmVideoFrame {
+    VkImageView view = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    uint32_t layer = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+};
+
+// current frame of a video stream, pushed to the video frame pipeline when drawn
 // should be created for every video stream
 struct VmVideoFrameStream {
     VmVideoFrameStreamId_t id;
-    VkImageView frameImageView = VK_NULL_HANDLE;            // the current video stream frame
-
-    // viewport
-    std::vector<VkDescriptorSet> vpDescriptorSetsInFlight;  // the viewport's descriptor sets in flight
-    std::vector<VkImageView> vpImageViewsInFlight;          // the current image view corrisponding to the descriptor set
-
-    // output
-    std::vector<VkDescriptorSet> outDescriptorSetsInFlight; // the output's descriptor sets in flight
-    std::vector<VkImageView> outImageViewsInFlight;         // the current image view corrisponding to the descriptor set
+    VmVideoFrame frame;             // the current video stream frame
 };
 
 class Scene;
@@ -94,11 +101,12 @@ private:
 
     const int MAX_FRAMES_IN_FLIGHT = 2;
 
+    // in PipelineId order
     const std::vector<PipelineToLoad> pipelinesToLoad = {
         PipelineToLoad{"color", "shaders/vert.spv", "shaders/col.spv", VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, {&uniformBufferLayout}},
-        PipelineToLoad{"texture", "shaders/vert.spv", "shaders/text.spv", VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, {&uniformBufferLayout, &textureLayout}},
+        PipelineToLoad{"texture", "shaders/vert.spv", "shaders/text.spv", VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, {&uniformBufferLayout, &textureArrayLayout}},
         PipelineToLoad{"line", "shaders/vert.spv", "shaders/col.spv", VK_PRIMITIVE_TOPOLOGY_LINE_STRIP, {&uniformBufferLayout} },
-        PipelineToLoad{"video_frame", "shaders/vert.spv", "shaders/text.spv", VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, {&uniformBufferLayout, &videoFrameLayout}},
+        PipelineToLoad{"video_frame", "shaders/vert.spv", "shaders/video_frame.spv", VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, {&uniformBufferLayout, &videoFrameLayout}},
     };
 
     const std::vector<const char*> validationLayers = {
@@ -108,16 +116,28 @@ private:
     const std::vector<const char*> deviceExtensions = {
         // presentation
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        // video decode
+        // video frames
         VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+    };
+
+    // optional, videos are decoded on the cpu without them
+    const std::vector<const char*> videoDecodeExtensions = {
         VK_KHR_VIDEO_QUEUE_EXTENSION_NAME,
         VK_KHR_VIDEO_DECODE_QUEUE_EXTENSION_NAME,
         VK_KHR_VIDEO_DECODE_H264_EXTENSION_NAME,
     };
     
+    // initial geometry arena capacity, grows on demand
     const uint32_t VERTICES_COUNT = 128;
     const uint32_t INDICES_COUNT = 128;
 
+    // initial indirect commands capacity, grows on demand
+    const uint32_t INDIRECT_DRAWS_COUNT = 128;
+
+    // texture array size when the device allows more, bounds the descriptor memory
+    const uint32_t MAX_TEXTURES_COUNT = 65536;
+
     GLFWwindow* window;
     VkInstance instance;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
@@ -130,10 +150,10 @@ private:
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    GeometryBuffer* pGeometry = nullptr;
+    DrawList drawList;
+    IndirectDraws* pIndirectDraws = nullptr;
+    float sceneUpdateSeconds = 0.0f;    // draw list, geometry and indirect draws of the last viewport frame
     VkDescriptorPool descriptorPool;
     std::vector<VkDescriptorSet> uniformBufferSets;
     
@@ -147,9 +167,15 @@ private:
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
 
+    // command pools - graphics, recorded on the decode thread (frame cache copies, cpu decode uploads)
+    VkCommandPool decodeCommandPool;
+
     // command pools - video decode
-    VkQueue videoQueue;
-    VkCommandPool videoCommandPool;
+    bool videoDecodeSupported = false;
+    VkQueue videoQueue = VK_NULL_HANDLE;
+    VkCommandPool videoCommandPool = VK_NULL_HANDLE;
+    DecodeScheduler* pDecodeScheduler = nullptr;
+    VideoSessionPool* pVideoSessionPool = nullptr;
 
     // queue families
     std::optional<uint32_t> graphicsFamily;
@@ -165,13 +191,18 @@ private:
     std::vector<VmTexture> textures;
 
     // pipelines
-    std::map<std::string, Pipeline> pipelines;
+    std::vector<Pipeline> pipelines;    // by PipelineId
 
     // descriptor set layouts
-    VkDescriptorSetLayout textureLayout;
-    VkDescriptorSetLayout videoFrameLayout;
+    VkDescriptorSetLayout textureArrayLayout;
+    VkDescriptorSetLayout videoFrameLayout;     // pushed
     VkDescriptorSetLayout uniformBufferLayout;
 
+    // every texture in one set, an element is written once when the texture is loaded
+    uint32_t texturesCapacity = 0;
+    VkDescriptorPool textureArrayPool;
+    VkDescriptorSet textureArraySet;
+
     // uniform buffer
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
@@ -191,6 +222,9 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
     uint32_t currentFrame = 0;
+
+    // the queues are used by the main and the decode thread, submits and device waits hold it
+    std::mutex queueMutex;
     
     // validation layer
     #ifdef NDEBUG
@@ -200,10 +234,6 @@ private:
     #endif
     bool checkValidationLayerSupport();
 
-    // command buffer
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 
     static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
@@ -214,7 +244,9 @@ private:
     
     int rateDeviceSuitability(VkPhysicalDevice device);
 
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions);
+
+    bool checkVideoDecodeSupport(VkPhysicalDevice device);
 
     void createSurface();
 
@@ -246,10 +278,6 @@ private:
 
     void createSamplers();
 
-    void createVertexBuffer();
-
-    void createIndexBuffer();
-
     void createDescriptorSetLayouts();
 
     void createUniformBuffers();
@@ -262,16 +290,14 @@ private:
 
     void updateUniformBuffer(uint32_t currentImage);
 
-    void updateVertexBuffer();
-
-    void updateIndexBuffer();
-
     void drawFrame();
 
     void cleanupSwapChain();
 
     // video frame streams
     std::vector<VmVideoFrameStream> vmVideoFrameStreams;
+    std::vector<VkImageMemoryBarrier2> videoFrameBarriers;
+    bool viewportSamplesDpb = false;    // the viewport command buffer moves dpb layers, submitted after the decodes
     
     //VkImageView prevVideoFrameView = VK_NULL_HANDLE;
 
@@ -300,8 +326,11 @@ public:
     VkInstance getInstance() { return instance; };
     
     // buffers
-    VkBuffer getVertexBuffer() { return vertexBuffer; };
-    VkBuffer getIndexBuffer() { return indexBuffer; };
+    GeometryBuffer* getGeometry() { return pGeometry; };   // viewport geometry
+    uint32_t getVerticesCount() { return VERTICES_COUNT; };
+    uint32_t getIndicesCount() { return INDICES_COUNT; };
+    uint32_t getIndirectDrawsCount() { return INDIRECT_DRAWS_COUNT; };
+    IndirectDraws* getIndirectDraws() { return pIndirectDraws; };     // viewport draws
 
     // textures
     VmTexture* getTexture(VmTextureId_t textureId);
@@ -311,7 +340,21 @@ public:
     VkDescriptorSetLayout getVideoFrameLayout() { return videoFrameLayout; };
 
     // pipelines
-    Pipeline getPipeline(std::string pipelineName);
+    Pipeline getPipeline(PipelineId pipelineId) { return pipelines[pipelineId]; };
+
+    // scene draws of the current frame, shared with the output
+    DrawList* getDrawList() { return &drawList; };
+    float getSceneUpdateSeconds() { return sceneUpdateSeconds; };
+
+    // textures are indexed by the instance data, the set is bound once with the texture pipeline
+    VkDescriptorSet getTextureArraySet() { return textureArraySet; };
+
+    // pushes the current frame of a video media for the video frame pipeline, false while it has nothing to show
+    bool pushVideoFrame(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int mediaId);
+
+    // moves the stream frames held in a dpb layout to the shader read layout before the render pass (toSample)
+    // and back after it, returns true when a dpb layer is moved, the command buffer is then submitted with DecodeScheduler::submitDpbAccess
+    bool recordVideoFrameBarriers(VkCommandBuffer commandBuffer, bool toSample);
     std::vector<PipelineToLoad> getPipelinesToLoad() { return pipelinesToLoad; };
 
     VmTextureId_t loadTexture(unsigned char* pixels, int width, int height);
@@ -321,19 +364,33 @@ public:
     VmVideoFrameStreamId_t createVideoFrameStream();
     VmVideoFrameStream* getVideoFrameStream(VmVideoFrameStreamId_t streamId);
     void removeVideoFrameStream(VmVideoFrameStreamId_t streamId);
-    void loadVideoFrame(VmVideoFrameStreamId_t vmVideoFrameStreamId, VkImageView videoFrameView);
+    void loadVideoFrame(VmVideoFrameStreamId_t vmVideoFrameStreamId, const VmVideoFrame& videoFrame);
     
     // physicalDevice
     VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
 
     // command buffers
     std::vector<VkCommandBuffer> getCommandBuffers() { return commandBuffers; }
+    VkCommandPool getCommandPool() { return commandPool; }
     VkCommandPool getVideoCommandPool() { return videoCommandPool; }
+    VkCommandPool getDecodeCommandPool() { return decodeCommandPool; }
+
+    // one time submit on the graphics queue, returns once executed
+    // pool defaults to the graphics command pool
+    VkCommandBuffer beginSingleTimeCommands(VkCommandPool pool = VK_NULL_HANDLE);
+    void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool pool = VK_NULL_HANDLE);
 
     // queues
     VkQueue getGraphicsQueue() { return graphicsQueue; }
     VkQueue getPresentQueue() { return presentQueue; }
     VkQueue getVideoQueue() { return videoQueue; }
+    DecodeScheduler* getDecodeScheduler() { return pDecodeScheduler; }  // null without video decode
+    VideoSessionPool* getVideoSessionPool() { return pVideoSessionPool; }  // null without video decode
+    bool hasVideoDecode() { return videoDecodeSupported; }
+
+    // queue submits and presents from any thread hold it
+    std::mutex& getQueueMutex() { return queueMutex; }
+    void waitDeviceIdle();
     
     // queue indexes
     uint32_t getGraphicsQueueFamilyIndex() { return graphicsFamily.value(); };
@@ -51,4 +51,11 @@ struct UniformBufferObject {
     glm::mat4 proj;
 };
 
+// per draw data, read by the vertex shader with gl_InstanceIndex (std430)
+struct InstanceData {
+    glm::vec4 tint;             // added to the vertex color
+    uint32_t textureIndex;      // element of the texture array, texture pipeline
+    uint32_t padding[3];
+};
+
 #endif
\ No newline at end of file
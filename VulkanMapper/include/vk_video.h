@@ -1,10 +1,12 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <chrono>
 #include <volk.h>
 #include "vk_state.h"
 #include "media_manager.h"
 #include "video.h"
+#include "video_decoder.h"
 
 class VulkanState;
 
@@ -15,21 +17,22 @@ struct VmTexture;
 
 struct Video;
 
-typedef struct {
-	uint8_t* buffer;
-	size_t size;
-} INPUT_BUFFER;
-
-struct DecodeFrameResult {
-	VkImageView frameImageView;
-	VkFence decodeFence;
-};
-
-class VulkanVideo {
+// hardware decode on the device video queue (VK_KHR_video_decode_h264)
+class VulkanVideo : public VideoDecoder {
 private:
 	VulkanState* pVkState;
 
-	VkCommandBuffer commandBuffer;
+	// decode info of the reference slots, sized once from the dpb slots and rewritten every frame
+	std::vector<VkVideoReferenceSlotInfoKHR> referenceSlotInfos;
+	std::vector<VkVideoPictureResourceInfoKHR> refPictureInfos;
+	std::vector<StdVideoDecodeH264ReferenceInfo> refH264Infos;
+	std::vector<VkVideoDecodeH264DpbSlotInfoKHR> refH264SlotInfos;
+	std::vector<VkImageMemoryBarrier2> dpbBarriers;	// reference layers then the setup layer
+
+	// one command buffer per decode in flight, used round robin
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<uint64_t> commandBufferValues;	// timeline value of the last decode recorded in each
+	uint32_t nextCommandBuffer = 0;
 
 	// sequence parameter set
 	std::vector<StdVideoH264SequenceParameterSet> spsArrayH264;
@@ -38,14 +41,11 @@ private:
 	std::vector<StdVideoH264PictureParameterSet> ppsArrayH264;
 
 	// video stream buffer
-	VkBuffer videoBitStreamBuffer;
-	VkDeviceMemory videoBitStreamBufferMemory;
+	VkBuffer videoBitStreamBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory videoBitStreamBufferMemory = VK_NULL_HANDLE;
 
-	// the backing store of DPB slots
-	VkImage dpbImage;	// multi layer
-	VkDeviceMemory dpbImageMemory;
-	VkImageView dpbImageView;
-	std::vector<VkImageView> decodedImageViews;
+	// video session and the backing store of DPB slots, from the session pool
+	PooledVideoSession* pSession = nullptr;
 
 	//uint32_t numReferenceFrames = 0;	// max number of frame used as reference (same as numDpbSlots)
 
@@ -57,25 +57,36 @@ private:
 	VkVideoCapabilitiesKHR videoCapabilities;
 	uint64_t bitStreamAlignment;
 
-	// video session
-	std::vector<VkDeviceMemory> videoSessionMemories;
-	VkVideoSessionParametersKHR videoSessionParameters;
-	VkVideoSessionKHR videoSession = VK_NULL_HANDLE;
+	// video session parameters, per video
+	VkVideoSessionParametersKHR videoSessionParameters = VK_NULL_HANDLE;
+	bool sessionReset = false;	// the session is reset once before its first decode
 
-	// sync
-	VkFence decodeFence;
+	// sync, decodes are submitted by the decode scheduler
+	uint64_t lastQueuedValue = 0;
 
 	void loadVideoData(Video* pVideo);
 	void createVideoSession(Video* pVideo);
-	void createDpbTextures(Video* pVideo);
 
 
 public:
 	VulkanVideo(VulkanState* pDevice);
 	~VulkanVideo();
-	DecodeFrameResult* decodeFrame(Video* pVideo);
+
+	const char* getName() override { return "Vulkan video"; }
+
+	// records the decode of the next frame and queues it on the decode scheduler,
+	// the result timeline value is the scheduler batch value
+	void decodeFrame(Video* pVideo, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) override;
+	bool canDecode() override;	// the next command buffer of the ring is done
+	bool isDecoded(DecodeFrameResult* pResult) override;
+	void getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) override;	// a layer of the session dpb image
+	void waitIdle() override;
 	
-	uint64_t queryDecodeVideoCapabilities();
-	void loadVideoStream(uint8_t* dataStream, size_t dataStreamSize);
-	void setupDecoder(Video* pVideo);
+	uint32_t clampDpbSlots(uint32_t dpbSlots) override;
+
+	uint64_t queryDecodeVideoCapabilities() override;
+	// creates the host visible bitstream buffer and returns it mapped
+	uint8_t* mapVideoStream(size_t dataStreamSize) override;
+	void unmapVideoStream() override;
+	void setupDecoder(Video* pVideo) override;
 };
\ No newline at end of file
@@ -5,3 +5,14 @@
 typedef uint8_t VmVideoFrameStreamId_t;
 
 typedef uint8_t MediaId_t;
+
+typedef uint32_t ObjectId_t;
+
+// index of a pipeline in VulkanState::pipelinesToLoad
+enum PipelineId : uint8_t {
+	ColorPipeline = 0,
+	TexturePipeline = 1,
+	LinePipeline = 2,
+	VideoFramePipeline = 3,
+	PipelinesCount = 4,
+};
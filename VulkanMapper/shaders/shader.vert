@@ -6,15 +6,27 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// per draw, indexed by the first instance of the indirect command
+struct Instance {
+    vec4 tint;
+    uint textureIndex;
+};
+
+layout(std430, binding = 1) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
 
 void main() {
     gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
+    fragColor = inColor + instances[gl_InstanceIndex].tint.rgb;
     fragTexCoord = inTexCoord;
+    fragTextureIndex = instances[gl_InstanceIndex].textureIndex;
 }
\ No newline at end of file
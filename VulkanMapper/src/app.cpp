@@ -28,6 +28,7 @@ void App::run() {
 
 void App::init() {
 	pVkState->init();
+	pMediaManager->init();
 }
 
 void App::cleanup() {
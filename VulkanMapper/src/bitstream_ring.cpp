@@ -0,0 +1,56 @@
+#include "../include/bitstream_ring.h"
+
+#include <stdexcept>
+
+BitstreamRing::BitstreamRing(uint64_t capacity, uint64_t alignment, uint32_t maxFrames) {
+    BitstreamRing::capacity = capacity;
+    BitstreamRing::alignment = alignment;
+    entries.resize(maxFrames);
+}
+
+bool BitstreamRing::push(uint32_t frame, uint64_t size, uint64_t& offset) {
+    uint64_t alignedSize = ((size + alignment - 1) / alignment) * alignment;
+    if (alignedSize > capacity) {
+        throw std::runtime_error("frame does not fit in the bitstream ring!");
+    }
+
+    // wrap to the beginning when the frame doesn't fit before the end
+    uint64_t start = head;
+    uint64_t skipped = 0;
+    if (start + alignedSize > capacity) {
+        skipped = capacity - start;
+        start = 0;
+    }
+
+    if (used + skipped + alignedSize > capacity || entriesCount == entries.size()) {
+        return false;   // full
+    }
+
+    entriesCount++;
+    getEntry(entriesCount - 1) = { frame, start, skipped + alignedSize };
+    used += skipped + alignedSize;
+    head = (start + alignedSize) % capacity;
+
+    offset = start;
+    return true;
+}
+
+void BitstreamRing::pop() {
+    used -= entries[firstEntry].consumed;
+    firstEntry = (firstEntry + 1) % entries.size();
+    entriesCount--;
+}
+
+bool BitstreamRing::contains(uint32_t frame) const {
+    for (uint32_t i = 0; i < entriesCount; i++) {
+        if (entries[(firstEntry + i) % entries.size()].frame == frame) return true;
+    }
+    return false;
+}
+
+void BitstreamRing::clear() {
+    firstEntry = 0;
+    entriesCount = 0;
+    head = 0;
+    used = 0;
+}
@@ -0,0 +1,254 @@
+#ifdef VM_CPU_DECODE
+
+#include "../include/cpu_decoder.h"
+#include "../include/mapped_file.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <minimp4.h>
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+std::vector<uint8_t> readParameterSets(const std::string& filePath) {
+    std::vector<uint8_t> parameterSets;
+    const uint8_t startCode[] = { 0, 0, 0, 1 };
+
+    MappedFile file(filePath);
+
+    MP4D_demux_t mp4 = { 0, };
+    MP4D_open(&mp4, mappedFileRead, &file, file.getSize());
+
+    for (uint32_t ntrack = 0; ntrack < mp4.track_count; ntrack++) {
+        MP4D_track_t& track = mp4.track[ntrack];
+        if (track.handler_type != MP4D_HANDLER_TYPE_VIDE || track.object_type_indication != MP4_OBJECT_TYPE_AVC) continue;
+
+        const void* data = nullptr;
+        int size = 0;
+        for (int index = 0; data = MP4D_read_sps(&mp4, ntrack, index, &size); index++) {
+            parameterSets.insert(parameterSets.end(), startCode, startCode + sizeof(startCode));
+            parameterSets.insert(parameterSets.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        }
+        for (int index = 0; data = MP4D_read_pps(&mp4, ntrack, index, &size); index++) {
+            parameterSets.insert(parameterSets.end(), startCode, startCode + sizeof(startCode));
+            parameterSets.insert(parameterSets.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        }
+        break;
+    }
+
+    MP4D_close(&mp4);
+
+    return parameterSets;
+}
+
+CpuDecoder::CpuDecoder(uint32_t threadCount) {
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    CpuDecoder::threadCount = std::clamp(threadCount, 1u, (uint32_t)CPU_DECODE_MAX_THREADS);
+
+    if (avcodec_find_decoder(AV_CODEC_ID_H264) == nullptr) {
+        throw std::runtime_error("libavcodec has no h264 decoder!");
+    }
+}
+
+CpuDecoder::~CpuDecoder() {
+    // stop worker
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            stopping = true;
+        }
+        jobsCondition.notify_all();
+        worker.join();
+    }
+
+    avcodec_free_context(&pCodecContext);
+}
+
+uint64_t CpuDecoder::getSlotSize(uint32_t width, uint32_t height) {
+    return ((uint64_t)width * height * 3 / 2 + 255) & ~255ull;
+}
+
+void CpuDecoder::open(const std::vector<uint8_t>& parameterSets, uint32_t width, uint32_t height, uint8_t* pSlots, uint32_t slotCount) {
+    CpuDecoder::width = width;
+    CpuDecoder::height = height;
+    CpuDecoder::pSlots = pSlots;
+    slotSize = getSlotSize(width, height);
+
+    const AVCodec* pCodec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    pCodecContext = avcodec_alloc_context3(pCodec);
+    if (pCodecContext == nullptr) {
+        throw std::runtime_error("failed to allocate h264 decoder!");
+    }
+
+    // frame threads when the stream allows it, slice threads otherwise
+    pCodecContext->thread_count = threadCount;
+    pCodecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    pCodecContext->extradata = (uint8_t*)av_mallocz(parameterSets.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+    std::memcpy(pCodecContext->extradata, parameterSets.data(), parameterSets.size());
+    pCodecContext->extradata_size = (int)parameterSets.size();
+
+    if (avcodec_open2(pCodecContext, pCodec, nullptr) < 0) {
+        throw std::runtime_error("failed to open h264 decoder!");
+    }
+
+    slotDecodedSequence.assign(slotCount, 0);
+
+    worker = std::thread(&CpuDecoder::workerLoop, this);
+}
+
+uint64_t CpuDecoder::queue(uint32_t slot, const uint8_t* pData, uint32_t size) {
+    DecodeJob job = {};
+    job.sequence = nextSequence++;
+    job.slot = slot;
+    job.pData = pData;
+    job.size = size;
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push_back(job);
+    }
+    jobsCondition.notify_all();
+
+    return job.sequence;
+}
+
+bool CpuDecoder::isDecoded(uint32_t slot, uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return slotDecodedSequence[slot] == sequence;
+}
+
+void CpuDecoder::cancel() {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    for (const DecodeJob& job : jobs) {
+        slotDecodedSequence[job.slot] = job.sequence;
+    }
+    jobs.clear();
+}
+
+void CpuDecoder::flush() {
+    if (!worker.joinable()) return;
+
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    jobs.clear();
+    flushing = true;
+    jobsCondition.notify_all();
+    jobsCondition.wait(lock, [this]() { return !flushing; });
+}
+
+void CpuDecoder::workerLoop() {
+    AVPacket* pPacket = av_packet_alloc();
+    AVFrame* pFrame = av_frame_alloc();
+    std::vector<DecodeJob> sentJobs;    // waiting for their picture
+
+    while (true) {
+        DecodeJob job;
+
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsCondition.wait(lock, [this]() { return stopping || flushing || !jobs.empty(); });
+
+            if (stopping) break;
+
+            if (flushing) {
+                avcodec_flush_buffers(pCodecContext);
+                sentJobs.clear();
+                flushing = false;
+                jobsCondition.notify_all();
+                continue;
+            }
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        // the decoder copies the packet, the bitstream can be refilled after send
+        pPacket->data = (uint8_t*)job.pData;
+        pPacket->size = (int)job.size;
+        pPacket->pts = (int64_t)job.sequence;
+        sentJobs.push_back(job);
+
+        int result;
+        while ((result = avcodec_send_packet(pCodecContext, pPacket)) == AVERROR(EAGAIN)) {
+            receiveFrames(pFrame, sentJobs);
+        }
+
+        if (result < 0) {
+            // broken frame, the slot keeps its previous picture
+            std::cerr << "cpu decode failed on job " << job.sequence << std::endl;
+            sentJobs.pop_back();
+            markDecoded(job);
+        }
+
+        receiveFrames(pFrame, sentJobs);
+    }
+
+    av_frame_free(&pFrame);
+    av_packet_free(&pPacket);
+}
+
+void CpuDecoder::receiveFrames(AVFrame* pFrame, std::vector<DecodeJob>& sentJobs) {
+    // pictures come out in display order, matched to their job by pts
+    while (avcodec_receive_frame(pCodecContext, pFrame) == 0) {
+        auto jobIt = std::find_if(sentJobs.begin(), sentJobs.end(), [pFrame](const DecodeJob& job) {
+            return (int64_t)job.sequence == pFrame->pts;
+            });
+
+        if (jobIt != sentJobs.end()) {
+            writeFrame(pFrame, jobIt->slot);
+            markDecoded(*jobIt);
+            sentJobs.erase(jobIt);
+        }
+
+        av_frame_unref(pFrame);
+    }
+}
+
+void CpuDecoder::markDecoded(const DecodeJob& job) {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    slotDecodedSequence[job.slot] = job.sequence;
+}
+
+void CpuDecoder::writeFrame(AVFrame* pFrame, uint32_t slot) {
+    uint8_t* pLuma = pSlots + slot * slotSize;
+    uint8_t* pChroma = pLuma + (uint64_t)width * height;
+
+    uint32_t copyWidth = std::min(width, (uint32_t)pFrame->width);
+    uint32_t copyHeight = std::min(height, (uint32_t)pFrame->height);
+
+    for (uint32_t y = 0; y < copyHeight; y++) {
+        std::memcpy(pLuma + (uint64_t)y * width, pFrame->data[0] + (int64_t)y * pFrame->linesize[0], copyWidth);
+    }
+
+    switch (pFrame->format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        // planar to interleaved chroma
+        for (uint32_t y = 0; y < copyHeight / 2; y++) {
+            const uint8_t* pU = pFrame->data[1] + (int64_t)y * pFrame->linesize[1];
+            const uint8_t* pV = pFrame->data[2] + (int64_t)y * pFrame->linesize[2];
+            uint8_t* pDst = pChroma + (uint64_t)y * width;
+            for (uint32_t x = 0; x < copyWidth / 2; x++) {
+                pDst[x * 2] = pU[x];
+                pDst[x * 2 + 1] = pV[x];
+            }
+        }
+        break;
+
+    case AV_PIX_FMT_NV12:
+        for (uint32_t y = 0; y < copyHeight / 2; y++) {
+            std::memcpy(pChroma + (uint64_t)y * width, pFrame->data[1] + (int64_t)y * pFrame->linesize[1], copyWidth);
+        }
+        break;
+
+    default:
+        std::cerr << "unsupported cpu decode pixel format: " << pFrame->format << std::endl;
+        break;
+    }
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifdef VM_CPU_DECODE
+
+#include "../include/cpu_video.h"
+#include "../include/vk_state.h"
+#include "../include/vk_video.h"
+#include "../include/video.h"
+
+#include <stdexcept>
+
+CpuVideo::CpuVideo(VulkanState* pVkState) {
+    CpuVideo::pVkState = pVkState;
+}
+
+CpuVideo::~CpuVideo() {
+    decoder.flush();
+    waitUploads();
+
+    // destroy uploads
+    if (!uploadCommandBuffers.empty()) {
+        vkFreeCommandBuffers(pVkState->getDevice(), pVkState->getDecodeCommandPool(), (uint32_t)uploadCommandBuffers.size(), uploadCommandBuffers.data());
+    }
+    for (auto uploadFence : uploadFences) {
+        vkDestroyFence(pVkState->getDevice(), uploadFence, nullptr);
+    }
+
+    // frames in flight may still sample the frame images
+    pVkState->waitDeviceIdle();
+
+    // destroy staging
+    if (pStagingData != nullptr) vkUnmapMemory(pVkState->getDevice(), stagingBufferMemory);
+    vkDestroyBuffer(pVkState->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(pVkState->getDevice(), stagingBufferMemory, nullptr);
+
+    // destroy frame images
+    for (auto frameImageView : frameImageViews) {
+        vkDestroyImageView(pVkState->getDevice(), frameImageView, nullptr);
+    }
+    vkDestroyImage(pVkState->getDevice(), frameImage, nullptr);
+    vkFreeMemory(pVkState->getDevice(), frameImageMemory, nullptr);
+}
+
+uint64_t CpuVideo::queryDecodeVideoCapabilities() {
+    return 1;   // packets are copied by the decoder, no alignment needed
+}
+
+uint32_t CpuVideo::clampDpbSlots(uint32_t dpbSlots) {
+    return dpbSlots;    // image array layers, no decoder limit
+}
+
+uint32_t CpuVideo::getDecodeLatency(Video* pVideo) {
+    // frame threads hold one frame each, reordering holds up to the reference frames
+    return (decoder.getThreadCount() - 1) + pVideo->numReferenceFrames;
+}
+
+uint8_t* CpuVideo::mapVideoStream(size_t dataStreamSize) {
+    bitStream.assign(dataStreamSize, 0);
+    return bitStream.data();
+}
+
+void CpuVideo::unmapVideoStream() {
+    // host memory, stays readable by the worker
+}
+
+void CpuVideo::setupDecoder(Video* pVideo) {
+    width = pVideo->width;
+    height = pVideo->height;
+
+    // frame images
+    pVkState->createImage(
+        width,
+        height,
+        pVideo->numDpbSlots,
+        FRAME_FORMAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        frameImage,
+        frameImageMemory,
+        nullptr
+    );
+    pVkState->transitionImageLayout(frameImage, FRAME_FORMAT, pVideo->numDpbSlots, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    frameImageViews.resize(pVideo->numDpbSlots);
+    for (uint32_t i = 0; i < pVideo->numDpbSlots; i++) {
+        VkSamplerYcbcrConversionInfo conversionInfo = {};
+        conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
+        conversionInfo.conversion = pVkState->getYcbcrSamplerConversion();
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frameImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FRAME_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = i;
+        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.pNext = &conversionInfo;
+
+        if (vkCreateImageView(pVkState->getDevice(), &viewInfo, nullptr, &frameImageViews[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+    }
+
+    // staging, nv12: luma plane then interleaved chroma plane
+    slotStagingSize = CpuDecoder::getSlotSize(width, height);
+    pVkState->createBuffer(
+        slotStagingSize * pVideo->numDpbSlots,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingBufferMemory,
+        nullptr
+    );
+
+    void* stagingData;
+    if (vkMapMemory(pVkState->getDevice(), stagingBufferMemory, 0, slotStagingSize * pVideo->numDpbSlots, 0, &stagingData) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map staging buffer memory!");
+    }
+    pStagingData = (uint8_t*)stagingData;
+
+    // uploads, recorded on the decode thread
+    uploadCommandBuffers.resize(pVideo->numDpbSlots);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = pVkState->getDecodeCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = pVideo->numDpbSlots;
+
+    if (vkAllocateCommandBuffers(pVkState->getDevice(), &allocInfo, uploadCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    uploadFences.resize(pVideo->numDpbSlots);
+    for (auto& uploadFence : uploadFences) {
+        if (vkCreateFence(pVkState->getDevice(), &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence!");
+        }
+    }
+
+    slotUploading.assign(pVideo->numDpbSlots, 0);
+    slotUploadedSequence.assign(pVideo->numDpbSlots, 0);
+
+    decoder.open(readParameterSets(pVideo->getFilePath()), width, height, pStagingData, pVideo->numDpbSlots);
+}
+
+void CpuVideo::decodeFrame(Video* pVideo, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) {
+    // jobs run in decode order, the deadline only orders the hardware path
+    const uint32_t frame = pResult->frame;
+    const uint32_t dpbSlot = pResult->dpbSlot;
+
+    pResult->timelineValue = decoder.queue(dpbSlot, bitStream.data() + pVideo->frames.offset[frame], pVideo->frames.size[frame]);
+}
+
+bool CpuVideo::isDecoded(DecodeFrameResult* pResult) {
+    uint32_t dpbSlot = pResult->dpbSlot;
+
+    if (slotUploadedSequence[dpbSlot] != pResult->timelineValue) {
+        if (!decoder.isDecoded(dpbSlot, pResult->timelineValue)) return false;
+
+        uploadSlot(dpbSlot);
+        slotUploadedSequence[dpbSlot] = pResult->timelineValue;
+    }
+
+    return pollUpload(dpbSlot);
+}
+
+void CpuVideo::getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) {
+    *pFrame = { frameImageViews[dpbSlot], frameImage, dpbSlot, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+}
+
+void CpuVideo::cancelDecodes() {
+    decoder.cancel();
+}
+
+void CpuVideo::waitIdle() {
+    decoder.flush();
+    waitUploads();
+}
+
+bool CpuVideo::pollUpload(uint32_t dpbSlot) {
+    if (!slotUploading[dpbSlot]) return true;
+    if (vkGetFenceStatus(pVkState->getDevice(), uploadFences[dpbSlot]) != VK_SUCCESS) return false;
+
+    vkResetFences(pVkState->getDevice(), 1, &uploadFences[dpbSlot]);
+    slotUploading[dpbSlot] = 0;
+    return true;
+}
+
+void CpuVideo::waitUploads() {
+    for (uint32_t i = 0; i < slotUploading.size(); i++) {
+        if (!slotUploading[i]) continue;
+
+        vkWaitForFences(pVkState->getDevice(), 1, &uploadFences[i], VK_TRUE, UINT64_MAX);
+        pollUpload(i);
+    }
+}
+
+void CpuVideo::uploadSlot(uint32_t dpbSlot) {
+    // runs on the decode thread, the slot's command buffer is not in flight
+    VkCommandBuffer commandBuffer = uploadCommandBuffers[dpbSlot];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = frameImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = dpbSlot;
+    barrier.subresourceRange.layerCount = 1;
+
+    // the layer may still be sampled by frames in flight
+    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // luma & chroma planes
+    VkBufferImageCopy regions[2] = {};
+    regions[0].bufferOffset = dpbSlot * slotStagingSize;
+    regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+    regions[0].imageSubresource.mipLevel = 0;
+    regions[0].imageSubresource.baseArrayLayer = dpbSlot;
+    regions[0].imageSubresource.layerCount = 1;
+    regions[0].imageExtent = { width, height, 1 };
+
+    regions[1].bufferOffset = dpbSlot * slotStagingSize + (uint64_t)width * height;
+    regions[1].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_1_BIT;
+    regions[1].imageSubresource.mipLevel = 0;
+    regions[1].imageSubresource.baseArrayLayer = dpbSlot;
+    regions[1].imageSubresource.layerCount = 1;
+    regions[1].imageExtent = { width / 2, height / 2, 1 };
+
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, frameImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, regions);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to end recording command buffer");
+    }
+
+    // polled by isDecoded, the decode thread doesn't wait on the copy
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    std::lock_guard<std::mutex> lock(pVkState->getQueueMutex());
+    if (vkQueueSubmit(pVkState->getGraphicsQueue(), 1, &submitInfo, uploadFences[dpbSlot]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit frame upload!");
+    }
+    slotUploading[dpbSlot] = 1;
+}
+
+#endif
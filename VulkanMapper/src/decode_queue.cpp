@@ -0,0 +1,87 @@
+#include "../include/decode_queue.h"
+
+#include <algorithm>
+
+DecodeQueue::DecodeQueue(DecodeSlots* pSlots, VideoDecoder* pDecoder) {
+    DecodeQueue::pSlots = pSlots;
+    DecodeQueue::pDecoder = pDecoder;
+
+    queued.reserve(pSlots->size());
+    inFlight.reserve(pSlots->size());
+}
+
+bool DecodeQueue::queue(Video* pVideo, const FrameTable& frames, uint32_t frame, bool present, std::chrono::steady_clock::time_point deadline) {
+    if (!pDecoder->canDecode()) return false;     // the backend is busy, retried next tick
+
+    int dpbSlot = pSlots->acquire();
+    if (dpbSlot < 0) return false;     // all slots in use, wait for a present
+
+    // reset dpb on intra frame
+    if (frames.type[frame] == FrameType::IntraFrame) {
+        pSlots->resetReferences();
+    }
+
+    // active references
+    pSlots->listReferences();
+
+    DpbSlot& slot = (*pSlots)[dpbSlot];
+    slot.frame = frame;
+    slot.poc = frames.poc[frame];
+    slot.frameNum = frames.frameNum[frame];
+    slot.decodeIndex = decodeCount++;
+
+    // the result is kept with the slot, the backend fills in its completion value
+    DecodeFrameResult* pResult = pSlots->getResult(dpbSlot);
+    pResult->frame = frame;
+    pResult->dpbSlot = (uint32_t)dpbSlot;
+    pDecoder->decodeFrame(pVideo, deadline, pResult);
+
+    inFlight.push_back(pResult);
+    slot.decoding = true;
+    if (present) {
+        queued.push_back(pResult);
+        slot.pending = true;
+    }
+
+    // dpb management
+    if (frames.referencePriority[frame] > 0) {   // if frame is used as reference
+        pSlots->markReference(dpbSlot);
+    }
+
+    return true;
+}
+
+void DecodeQueue::retire() {
+    for (size_t i = 0; i < inFlight.size();) {
+        DecodeFrameResult* pResult = inFlight[i];
+        if (!pDecoder->isDecoded(pResult)) {
+            i++;
+            continue;
+        }
+
+        (*pSlots)[pResult->dpbSlot].decoding = false;
+        inFlight.erase(inFlight.begin() + i);
+    }
+}
+
+void DecodeQueue::flush() {
+    // nothing waits, queued backend work that has not started is dropped
+    pDecoder->cancelDecodes();
+
+    for (DecodeFrameResult* pResult : queued) {
+        (*pSlots)[pResult->dpbSlot].pending = false;
+    }
+    queued.clear();
+}
+
+DecodeFrameResult* DecodeQueue::find(const FrameTable& frames, uint32_t displayOrder) {
+    auto resultIt = std::find_if(queued.begin(), queued.end(), [&frames, displayOrder](DecodeFrameResult* pResult) {
+        return (uint32_t)frames.displayOrder[pResult->frame] == displayOrder;
+        });
+    return resultIt != queued.end() ? *resultIt : nullptr;
+}
+
+void DecodeQueue::remove(DecodeFrameResult* pResult) {
+    (*pSlots)[pResult->dpbSlot].pending = false;
+    queued.erase(std::find(queued.begin(), queued.end(), pResult));
+}
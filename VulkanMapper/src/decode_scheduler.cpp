@@ -0,0 +1,184 @@
+#include "../include/decode_scheduler.h"
+#include "../include/vk_state.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DecodeScheduler::DecodeScheduler(VulkanState* pVkState) {
+    DecodeScheduler::pVkState = pVkState;
+
+    VkSemaphoreTypeCreateInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(pVkState->getDevice(), &semaphoreInfo, nullptr, &decodeTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create decode timeline semaphore!");
+    }
+
+    if (vkCreateSemaphore(pVkState->getDevice(), &semaphoreInfo, nullptr, &dpbAccessTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create dpb access timeline semaphore!");
+    }
+}
+
+DecodeScheduler::~DecodeScheduler() {
+    submit();
+    waitFor(submittedValue);
+
+    vkDestroySemaphore(pVkState->getDevice(), decodeTimeline, nullptr);
+    vkDestroySemaphore(pVkState->getDevice(), dpbAccessTimeline, nullptr);
+}
+
+void DecodeScheduler::beginTick() {
+    vkGetSemaphoreCounterValue(pVkState->getDevice(), decodeTimeline, &completedValue);
+}
+
+uint64_t DecodeScheduler::queueDecode(VkCommandBuffer commandBuffer, std::chrono::steady_clock::time_point deadline) {
+    submissions.push_back({ commandBuffer, deadline });
+    return submittedValue + 1;
+}
+
+void DecodeScheduler::submit() {
+    stats.lastBatchSize = (uint32_t)submissions.size();
+    if (submissions.empty()) return;
+
+    // most urgent video first, stable so each video keeps its decode order
+    // insertion sort, batches are small and std::stable_sort allocates a buffer
+    for (size_t i = 1; i < submissions.size(); i++) {
+        DecodeSubmission submission = submissions[i];
+        size_t j = i;
+        while (j > 0 && submission.deadline < submissions[j - 1].deadline) {
+            submissions[j] = submissions[j - 1];
+            j--;
+        }
+        submissions[j] = submission;
+    }
+
+    batchCommandBuffers.clear();
+    for (const DecodeSubmission& submission : submissions) {
+        batchCommandBuffers.push_back(submission.commandBuffer);
+    }
+
+    uint64_t signalValue = submittedValue + 1;
+
+    {
+        std::lock_guard<std::mutex> lock(pVkState->getQueueMutex());
+
+        // after the graphics work that moved dpb layers out of the dpb layout
+        uint64_t waitValue = dpbAccessValue;
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &dpbAccessTimeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = (uint32_t)batchCommandBuffers.size();
+        submitInfo.pCommandBuffers = batchCommandBuffers.data();
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &decodeTimeline;
+
+        if (vkQueueSubmit(pVkState->getVideoQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit decode command buffers!");
+        }
+
+        submittedValue = signalValue;
+    }
+
+    stats.batchesSubmitted++;
+    stats.decodesSubmitted += submissions.size();
+    submissions.clear();
+}
+
+VkResult DecodeScheduler::submitDpbAccess(VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence) {
+    // after every decode submitted so far, one of them may still read or write the layers
+    VkSemaphore waitSemaphores[2] = {};
+    VkPipelineStageFlags waitStages[2] = {};
+    uint64_t waitValues[2] = {};    // binary semaphores ignore their value
+    uint32_t waitCount = 0;
+    if (submitInfo.waitSemaphoreCount > 0) {
+        waitSemaphores[waitCount] = submitInfo.pWaitSemaphores[0];
+        waitStages[waitCount] = submitInfo.pWaitDstStageMask[0];
+        waitCount++;
+    }
+    waitSemaphores[waitCount] = decodeTimeline;
+    waitStages[waitCount] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    waitValues[waitCount] = submittedValue;
+    waitCount++;
+
+    // the next decode batch waits for it
+    uint64_t signalValue = dpbAccessValue + 1;
+    VkSemaphore signalSemaphores[2] = {};
+    uint64_t signalValues[2] = {};
+    uint32_t signalCount = 0;
+    if (submitInfo.signalSemaphoreCount > 0) {
+        signalSemaphores[signalCount] = submitInfo.pSignalSemaphores[0];
+        signalCount++;
+    }
+    signalSemaphores[signalCount] = dpbAccessTimeline;
+    signalValues[signalCount] = signalValue;
+    signalCount++;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo accessSubmitInfo = submitInfo;
+    accessSubmitInfo.pNext = &timelineInfo;
+    accessSubmitInfo.waitSemaphoreCount = waitCount;
+    accessSubmitInfo.pWaitSemaphores = waitSemaphores;
+    accessSubmitInfo.pWaitDstStageMask = waitStages;
+    accessSubmitInfo.signalSemaphoreCount = signalCount;
+    accessSubmitInfo.pSignalSemaphores = signalSemaphores;
+
+    VkResult result = vkQueueSubmit(queue, 1, &accessSubmitInfo, fence);
+    if (result == VK_SUCCESS) dpbAccessValue = signalValue;
+
+    return result;
+}
+
+void DecodeScheduler::waitFor(uint64_t value) {
+    if (value > submittedValue) submit();
+    if (value == 0 || completedValue >= value) return;
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &decodeTimeline;
+    waitInfo.pValues = &value;
+
+    vkWaitSemaphores(pVkState->getDevice(), &waitInfo, UINT64_MAX);
+}
+
+bool DecodeScheduler::waitNext(std::chrono::steady_clock::time_point until) {
+    if (submittedValue <= completedValue) return false;     // nothing in flight
+
+    std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+    uint64_t timeout = 0;
+    if (until > currentTime) timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(until - currentTime).count();
+
+    uint64_t value = completedValue + 1;
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &decodeTimeline;
+    waitInfo.pValues = &value;
+
+    return vkWaitSemaphores(pVkState->getDevice(), &waitInfo, timeout) == VK_SUCCESS;
+}
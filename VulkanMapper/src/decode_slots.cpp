@@ -0,0 +1,45 @@
+#include "../include/decode_slots.h"
+
+void DecodeSlots::resize(uint32_t slotsCount, uint32_t numReferenceFrames) {
+    DecodeSlots::numReferenceFrames = numReferenceFrames;
+
+    slots.assign(slotsCount, DpbSlot());
+    results.assign(slotsCount, DecodeFrameResult());
+    referencesPositions.reserve(slotsCount);
+}
+
+int DecodeSlots::acquire() {
+    for (int i = 0; i < slots.size(); i++) {
+        if (!slots[i].reference && !slots[i].decoding && !slots[i].pending && !slots[i].presented && !slots[i].capturing) return i;
+    }
+    return -1;  // all slots in use, wait for a present
+}
+
+void DecodeSlots::resetReferences() {
+    for (DpbSlot& slot : slots) slot.reference = false;
+}
+
+void DecodeSlots::listReferences() {
+    referencesPositions.clear();
+    for (int i = 0; i < slots.size(); i++) {
+        if (slots[i].reference) referencesPositions.push_back(i);
+    }
+}
+
+void DecodeSlots::markReference(int slot) {
+    // Rec. ITU-T H.264 (08/2021) 8.2.5.3, memory management control operations are not supported
+    while (true) {
+        int oldestSlot = -1;
+        uint32_t referencesCount = 0;
+        for (int i = 0; i < slots.size(); i++) {
+            if (!slots[i].reference) continue;
+            referencesCount++;
+            if (oldestSlot < 0 || slots[i].decodeIndex < slots[oldestSlot].decodeIndex) oldestSlot = i;
+        }
+
+        if (referencesCount < numReferenceFrames) break;
+        slots[oldestSlot].reference = false;
+    }
+
+    slots[slot].reference = true;
+}
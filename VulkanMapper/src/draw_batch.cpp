@@ -0,0 +1,15 @@
+#include "../include/draw_batch.h"
+
+void batchPackets(const std::vector<DrawPacket>& packets, std::vector<DrawBatch>& batches) {
+    batches.clear();
+
+    for (uint32_t i = 0; i < packets.size(); i++) {
+        const DrawPacket& packet = packets[i];
+
+        // a batch ends when the pipeline or the material changes, the draw order is never changed
+        if (batches.empty() || batches.back().pipelineId != packet.pipelineId || batches.back().materialId != packet.materialId) {
+            batches.push_back({ packet.pipelineId, packet.materialId, i, 0 });
+        }
+        batches.back().commandCount++;
+    }
+}
@@ -0,0 +1,55 @@
+#include "../include/draw_list.h"
+#include "../include/scene_objects.h"
+
+#include <algorithm>
+
+void DrawList::build(const std::vector<Object*>& objects, uint64_t sceneRevision) {
+    // the previous order is kept while the objects are the same, the packets are then sorted unless a layer changed
+    bool reset = !isCurrent(sceneRevision) || packets.size() != objects.size();
+    if (reset) {
+        packets.resize(objects.size());
+        for (uint32_t i = 0; i < packets.size(); i++) {
+            packets[i].objectIndex = i;
+        }
+    }
+
+    for (DrawPacket& packet : packets) {
+        Object* pObject = objects[packet.objectIndex];
+
+        packet.pipelineId = pObject->getPipelineId();
+        packet.materialId = pObject->getMaterialId();
+        // the stacking order is kept, state is grouped only where neighbours already share it
+        packet.key = (uint64_t)pObject->getDrawLayer() << 32 | packet.objectIndex;
+    }
+
+    if (reset) {
+        std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+    }
+    else {
+        // insertion sort, linear when no layer changed since the last frame
+        for (size_t i = 1; i < packets.size(); i++) {
+            DrawPacket packet = packets[i];
+            size_t j = i;
+            while (j > 0 && packet.key < packets[j - 1].key) {
+                packets[j] = packets[j - 1];
+                j--;
+            }
+            packets[j] = packet;
+        }
+    }
+
+    pipelineChanges = 0;
+    materialChanges = 0;
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (i == 0 || packets[i].pipelineId != packets[i - 1].pipelineId) {
+            pipelineChanges++;
+            materialChanges++;
+        }
+        else if (packets[i].materialId != packets[i - 1].materialId) {
+            materialChanges++;
+        }
+    }
+
+    DrawList::sceneRevision = sceneRevision;
+    built = true;
+}
@@ -0,0 +1,448 @@
+#include "../include/frame_cache.h"
+#include "../include/vk_state.h"
+#include "../include/vk_video.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+FrameCache::FrameCache(VulkanState* pVkState, uint32_t width, uint32_t height, uint32_t framesCount) {
+    FrameCache::pVkState = pVkState;
+    FrameCache::width = width;
+    FrameCache::height = height;
+    FrameCache::framesCount = framesCount;
+
+    cachedFrames.resize(framesCount);
+    blockLayers = std::max(1u, std::min((uint32_t)FRAME_CACHE_BLOCK_FRAMES, framesCount));
+
+    // block size from an image never bound, the budget is known before the first capture
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = blockLayers;
+    imageInfo.format = FRAME_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage probeImage;
+    if (vkCreateImage(pVkState->getDevice(), &imageInfo, nullptr, &probeImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(pVkState->getDevice(), probeImage, &memRequirements);
+    blockBytes = memRequirements.size;
+
+    vkDestroyImage(pVkState->getDevice(), probeImage, nullptr);
+
+    // capture command buffers, recorded on the decode thread
+    captures.resize(FRAME_CACHE_CAPTURES_IN_FLIGHT);
+
+    std::vector<VkCommandBuffer> commandBuffers(captures.size());
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = pVkState->getDecodeCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+
+    if (vkAllocateCommandBuffers(pVkState->getDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (uint32_t i = 0; i < captures.size(); i++) {
+        captures[i].commandBuffer = commandBuffers[i];
+        if (vkCreateFence(pVkState->getDevice(), &fenceInfo, nullptr, &captures[i].fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence!");
+        }
+    }
+}
+
+FrameCache::~FrameCache() {
+    // cached frames may still be sampled by frames in flight
+    if (cachedCount > 0) pVkState->waitDeviceIdle();
+
+    waitIdle();
+    submitRetired();
+    for (RetiredBlock& retiredBlock : retiredBlocks) {
+        vkWaitForFences(pVkState->getDevice(), 1, &retiredBlock.fence, VK_TRUE, UINT64_MAX);
+    }
+    releaseRetired();
+
+    for (CacheBlock& block : blocks) {
+        if (block.image != VK_NULL_HANDLE) destroyBlock(block);
+    }
+
+    for (Capture& capture : captures) {
+        vkDestroyFence(pVkState->getDevice(), capture.fence, nullptr);
+        vkFreeCommandBuffers(pVkState->getDevice(), pVkState->getDecodeCommandPool(), 1, &capture.commandBuffer);
+    }
+}
+
+void FrameCache::createBlock(CacheBlock& block) {
+    pVkState->createImage(
+        width,
+        height,
+        blockLayers,
+        FRAME_FORMAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        block.image,
+        block.memory,
+        nullptr
+    );
+
+    VkSamplerYcbcrConversionInfo conversionInfo = {};
+    conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
+    conversionInfo.conversion = pVkState->getYcbcrSamplerConversion();
+
+    // a 2d view per layer, sampled like a decoded frame
+    block.views.resize(blockLayers);
+    for (uint32_t layer = 0; layer < blockLayers; layer++) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = block.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FRAME_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = layer;
+        viewInfo.subresourceRange.layerCount = 1;
+        viewInfo.pNext = &conversionInfo;
+
+        if (vkCreateImageView(pVkState->getDevice(), &viewInfo, nullptr, &block.views[layer]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+    }
+
+    block.layerFrames.assign(blockLayers, UINT32_MAX);
+    block.usedLayers = 0;
+    usedBytes += blockBytes;
+}
+
+void FrameCache::destroyBlock(CacheBlock& block) {
+    for (VkImageView view : block.views) {
+        vkDestroyImageView(pVkState->getDevice(), view, nullptr);
+    }
+    vkDestroyImage(pVkState->getDevice(), block.image, nullptr);
+    vkFreeMemory(pVkState->getDevice(), block.memory, nullptr);
+
+    block = {};
+}
+
+void FrameCache::evict(uint32_t displayOrder) {
+    CachedFrame& cachedFrame = cachedFrames[displayOrder];
+    CacheBlock& block = blocks[cachedFrame.block];
+
+    // the layer is free right away, the next capture into it is ordered after its last use on the queue
+    block.layerFrames[cachedFrame.layer] = UINT32_MAX;
+    block.usedLayers--;
+
+    // an empty block is retired, its memory goes back once the queue is past it
+    if (block.usedLayers == 0) {
+        RetiredBlock retiredBlock;
+        retiredBlock.block = std::move(block);
+        retiredBlocks.push_back(std::move(retiredBlock));
+        block = {};
+        usedBytes -= blockBytes;
+    }
+
+    lru.erase(cachedFrame.lruIt);
+    cachedFrame = {};
+    cachedCount--;
+}
+
+void FrameCache::submitRetired() {
+    bool unmarked = std::any_of(retiredBlocks.begin(), retiredBlocks.end(), [](const RetiredBlock& retiredBlock) {
+        return retiredBlock.fence == VK_NULL_HANDLE;
+        });
+    if (!unmarked) return;
+
+    // copies recorded into the retired blocks go first
+    submitCaptures();
+
+    // evicted frames are not published anymore, the renderer submitted its last draw of them
+    // an empty submit signals once every earlier submit on the graphics queue is done
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    if (vkCreateFence(pVkState->getDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pVkState->getQueueMutex());
+        if (vkQueueSubmit(pVkState->getGraphicsQueue(), 0, nullptr, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit frame cache retire marker!");
+        }
+    }
+
+    // the blocks retired together share the fence, the last one to be released destroys it
+    for (RetiredBlock& retiredBlock : retiredBlocks) {
+        if (retiredBlock.fence == VK_NULL_HANDLE) retiredBlock.fence = fence;
+    }
+}
+
+void FrameCache::releaseRetired() {
+    for (uint32_t i = 0; i < retiredBlocks.size(); ) {
+        VkFence fence = retiredBlocks[i].fence;
+        if (fence == VK_NULL_HANDLE || vkGetFenceStatus(pVkState->getDevice(), fence) != VK_SUCCESS) {
+            i++;
+            continue;
+        }
+
+        destroyBlock(retiredBlocks[i].block);
+        retiredBlocks.erase(retiredBlocks.begin() + i);
+
+        bool shared = std::any_of(retiredBlocks.begin(), retiredBlocks.end(), [fence](const RetiredBlock& retiredBlock) {
+            return retiredBlock.fence == fence;
+            });
+        if (!shared) vkDestroyFence(pVkState->getDevice(), fence, nullptr);
+    }
+}
+
+void FrameCache::setBudget(uint64_t budget, const std::function<bool(uint32_t)>& isShown) {
+    FrameCache::budget = budget;
+    releaseRetired();
+    if (usedBytes <= budget) return;
+
+    // whole blocks go, in the order of their least recently presented frame
+    std::vector<int32_t> blockOrder;
+    for (uint32_t displayOrder : lru) {
+        int32_t block = cachedFrames[displayOrder].block;
+        if (std::find(blockOrder.begin(), blockOrder.end(), block) == blockOrder.end()) blockOrder.push_back(block);
+    }
+
+    for (int32_t blockIndex : blockOrder) {
+        if (usedBytes <= budget) break;
+
+        // a frame the renderer may still show keeps its block
+        std::vector<uint32_t> layerFrames = blocks[blockIndex].layerFrames;
+        bool shown = std::any_of(layerFrames.begin(), layerFrames.end(), [&isShown](uint32_t displayOrder) {
+            return displayOrder != UINT32_MAX && isShown(displayOrder);
+            });
+        if (shown) continue;
+
+        for (uint32_t displayOrder : layerFrames) {
+            if (displayOrder != UINT32_MAX) evict(displayOrder);
+        }
+    }
+
+    submitRetired();
+}
+
+void FrameCache::evictWhere(const std::function<bool(uint32_t)>& shouldEvict) {
+    releaseRetired();
+
+    // frames still sampled by frames in flight keep their block alive until the retire marker signals
+    for (uint32_t i = 0; i < framesCount; i++) {
+        if (contains(i) && shouldEvict(i)) evict(i);
+    }
+
+    submitRetired();
+}
+
+bool FrameCache::capture(uint32_t displayOrder, VkImage srcImage, uint32_t srcLayer, VkImageLayout srcLayout) {
+    if (contains(displayOrder)) return true;
+
+    releaseRetired();
+
+    // a new batch takes the next command buffer of the ring, once the batch that last used it ran
+    if (recordingCapture < 0) {
+        Capture& nextBatch = captures[nextCapture];
+        if (nextBatch.pending) {
+            if (vkGetFenceStatus(pVkState->getDevice(), nextBatch.fence) != VK_SUCCESS) return false;
+
+            vkResetFences(pVkState->getDevice(), 1, &nextBatch.fence);
+            nextBatch.pending = false;
+        }
+    }
+
+    // a free layer of a live block, or a new block within the budget
+    int32_t blockIndex = -1;
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].image != VK_NULL_HANDLE && blocks[i].usedLayers < blockLayers) {
+            blockIndex = (int32_t)i;
+            break;
+        }
+    }
+
+    if (blockIndex < 0) {
+        if (usedBytes + blockBytes > budget) return false;
+
+        auto freeIt = std::find_if(blocks.begin(), blocks.end(), [](const CacheBlock& block) { return block.image == VK_NULL_HANDLE; });
+        if (freeIt == blocks.end()) freeIt = blocks.insert(blocks.end(), CacheBlock());
+        blockIndex = (int32_t)(freeIt - blocks.begin());
+
+        createBlock(blocks[blockIndex]);
+    }
+
+    CacheBlock& block = blocks[blockIndex];
+    uint32_t layer = (uint32_t)(std::find(block.layerFrames.begin(), block.layerFrames.end(), UINT32_MAX) - block.layerFrames.begin());
+    block.layerFrames[layer] = displayOrder;
+    block.usedLayers++;
+
+    CachedFrame& cachedFrame = cachedFrames[displayOrder];
+    cachedFrame.block = blockIndex;
+    cachedFrame.layer = layer;
+    cachedFrame.lruIt = lru.insert(lru.end(), displayOrder);
+    cachedCount++;
+
+    // a batch starts on the next command buffer of the ring, checked free above
+    if (recordingCapture < 0) {
+        recordingCapture = (int32_t)nextCapture;
+        nextCapture = (nextCapture + 1) % captures.size();
+
+        Capture& capture = captures[recordingCapture];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(capture.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+    }
+
+    // record copy
+    Capture& capture = captures[recordingCapture];
+
+    VkImageMemoryBarrier2 barriers[2] = {};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    // source layer, after the draws sampling it, a dpb layer after the decodes by the submit semaphores
+    barriers[0].image = srcImage;
+    barriers[0].subresourceRange.baseArrayLayer = srcLayer;
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    barriers[0].oldLayout = srcLayout;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    if (srcLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) recordingDpbCopies = true;
+
+    // cached layer, a reused one may still be sampled by earlier draws on the queue, the fragment stage dependency orders the copy after them
+    barriers[1].image = block.image;
+    barriers[1].subresourceRange.baseArrayLayer = layer;
+    barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 2;
+    dependencyInfo.pImageMemoryBarriers = barriers;
+    vkCmdPipelineBarrier2(capture.commandBuffer, &dependencyInfo);
+
+    // luma & chroma planes
+    VkImageCopy regions[2] = {};
+    regions[0].srcSubresource = { VK_IMAGE_ASPECT_PLANE_0_BIT, 0, srcLayer, 1 };
+    regions[0].dstSubresource = { VK_IMAGE_ASPECT_PLANE_0_BIT, 0, layer, 1 };
+    regions[0].extent = { width, height, 1 };
+    regions[1].srcSubresource = { VK_IMAGE_ASPECT_PLANE_1_BIT, 0, srcLayer, 1 };
+    regions[1].dstSubresource = { VK_IMAGE_ASPECT_PLANE_1_BIT, 0, layer, 1 };
+    regions[1].extent = { width / 2, height / 2, 1 };
+
+    vkCmdCopyImage(capture.commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, block.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, regions);
+
+    // the source goes back to its layout, the cached layer is sampled
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barriers[0].dstAccessMask = srcLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ? VK_ACCESS_2_SHADER_SAMPLED_READ_BIT : 0;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout = srcLayout;
+
+    barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barriers[1].srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier2(capture.commandBuffer, &dependencyInfo);
+
+    return true;
+}
+
+uint64_t FrameCache::submitCaptures() {
+    if (recordingCapture < 0) return captureSequence;
+
+    Capture& capture = captures[recordingCapture];
+    recordingCapture = -1;
+
+    if (vkEndCommandBuffer(capture.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to end recording command buffer");
+    }
+
+    // submit, polled by isCaptured and by the capture that comes back to it on the ring
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &capture.commandBuffer;
+
+    {
+        std::lock_guard<std::mutex> lock(pVkState->getQueueMutex());
+        VkResult submitResult = recordingDpbCopies
+            ? pVkState->getDecodeScheduler()->submitDpbAccess(pVkState->getGraphicsQueue(), submitInfo, capture.fence)
+            : vkQueueSubmit(pVkState->getGraphicsQueue(), 1, &submitInfo, capture.fence);
+        if (submitResult != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit frame cache copy!");
+        }
+    }
+    recordingDpbCopies = false;
+    capture.sequence = ++captureSequence;
+    capture.pending = true;
+
+    return capture.sequence;
+}
+
+bool FrameCache::isCaptured(uint64_t sequence) {
+    for (Capture& capture : captures) {
+        if (!capture.pending || capture.sequence > sequence) continue;
+        if (vkGetFenceStatus(pVkState->getDevice(), capture.fence) != VK_SUCCESS) return false;
+
+        vkResetFences(pVkState->getDevice(), 1, &capture.fence);
+        capture.pending = false;
+    }
+
+    return true;
+}
+
+VkImageView FrameCache::use(uint32_t displayOrder) {
+    CachedFrame& cachedFrame = cachedFrames[displayOrder];
+    lru.splice(lru.end(), lru, cachedFrame.lruIt);
+    return blocks[cachedFrame.block].views[cachedFrame.layer];
+}
+
+void FrameCache::waitIdle() {
+    submitCaptures();
+
+    for (Capture& capture : captures) {
+        if (!capture.pending) continue;
+
+        vkWaitForFences(pVkState->getDevice(), 1, &capture.fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(pVkState->getDevice(), 1, &capture.fence);
+        capture.pending = false;
+    }
+}
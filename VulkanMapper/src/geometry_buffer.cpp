@@ -0,0 +1,205 @@
+#include "../include/geometry_buffer.h"
+#include "../include/vk_state.h"
+#include "../include/scene_objects.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+static uint32_t getIndexSize(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+GeometryBuffer::GeometryBuffer(VulkanState* pVkState, uint32_t framesInFlight, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    GeometryBuffer::pVkState = pVkState;
+    GeometryBuffer::framesInFlight = framesInFlight;
+
+    vertexAllocator = RangeAllocator(vertexCapacity);
+    indexAllocator = RangeAllocator(indexCapacity);
+
+    regions.resize(framesInFlight);
+    for (auto& region : regions) {
+        fitRegion(region);
+    }
+}
+
+GeometryBuffer::~GeometryBuffer() {
+    for (auto& region : regions) {
+        vkUnmapMemory(pVkState->getDevice(), region.vertexMemory);
+        vkDestroyBuffer(pVkState->getDevice(), region.vertexBuffer, nullptr);
+        vkFreeMemory(pVkState->getDevice(), region.vertexMemory, nullptr);
+
+        vkUnmapMemory(pVkState->getDevice(), region.indexMemory);
+        vkDestroyBuffer(pVkState->getDevice(), region.indexBuffer, nullptr);
+        vkFreeMemory(pVkState->getDevice(), region.indexMemory, nullptr);
+    }
+}
+
+void GeometryBuffer::fitRegion(Region& region) {
+    VkDevice device = pVkState->getDevice();
+
+    // host visible and mapped once, read by the vertex input directly
+    if (region.vertexCapacity < vertexAllocator.getCapacity()) {
+        VkBuffer vertexBuffer;
+        VkDeviceMemory vertexMemory;
+        Vertex* pVertices;
+
+        VkDeviceSize vertexBytes = sizeof(Vertex) * vertexAllocator.getCapacity();
+        pVkState->createBuffer(vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffer, vertexMemory, nullptr);
+        vkMapMemory(device, vertexMemory, 0, vertexBytes, 0, (void**)&pVertices);
+
+        // objects that did not change are not rewritten, keep them
+        if (region.vertexBuffer != VK_NULL_HANDLE) {
+            memcpy(pVertices, region.pVertices, sizeof(Vertex) * region.vertexCapacity);
+
+            vkUnmapMemory(device, region.vertexMemory);
+            vkDestroyBuffer(device, region.vertexBuffer, nullptr);
+            vkFreeMemory(device, region.vertexMemory, nullptr);
+        }
+
+        region.vertexBuffer = vertexBuffer;
+        region.vertexMemory = vertexMemory;
+        region.pVertices = pVertices;
+        region.vertexCapacity = vertexAllocator.getCapacity();
+    }
+
+    if (region.indexCapacity < indexAllocator.getCapacity() || region.indexType != indexType) {
+        VkBuffer indexBuffer;
+        VkDeviceMemory indexMemory;
+        void* pIndices;
+
+        VkDeviceSize indexBytes = (VkDeviceSize)getIndexSize(indexType) * indexAllocator.getCapacity();
+        pVkState->createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indexBuffer, indexMemory, nullptr);
+        vkMapMemory(device, indexMemory, 0, indexBytes, 0, &pIndices);
+
+        if (region.indexBuffer != VK_NULL_HANDLE) {
+            if (region.indexType == indexType) {
+                memcpy(pIndices, region.pIndices, (size_t)getIndexSize(indexType) * region.indexCapacity);
+            }
+            else {
+                // widened to 32 bit
+                for (uint32_t i = 0; i < region.indexCapacity; i++) {
+                    ((uint32_t*)pIndices)[i] = ((uint16_t*)region.pIndices)[i];
+                }
+            }
+
+            vkUnmapMemory(device, region.indexMemory);
+            vkDestroyBuffer(device, region.indexBuffer, nullptr);
+            vkFreeMemory(device, region.indexMemory, nullptr);
+        }
+
+        region.indexBuffer = indexBuffer;
+        region.indexMemory = indexMemory;
+        region.pIndices = pIndices;
+        region.indexCapacity = indexAllocator.getCapacity();
+        region.indexType = indexType;
+    }
+}
+
+void GeometryBuffer::allocate(Slot& slot, uint32_t vertexCount, uint32_t indexCount) {
+    // the arena doubles, regions follow when their frame is updated
+    while (!vertexAllocator.allocate(vertexCount, slot.range.firstVertex)) {
+        vertexAllocator.grow(std::max(vertexAllocator.getCapacity() * 2, vertexAllocator.getCapacity() + vertexCount));
+    }
+    while (!indexAllocator.allocate(indexCount, slot.range.firstIndex)) {
+        indexAllocator.grow(std::max(indexAllocator.getCapacity() * 2, indexAllocator.getCapacity() + indexCount));
+    }
+
+    slot.range.vertexCount = vertexCount;
+    slot.range.indexCount = indexCount;
+}
+
+void GeometryBuffer::free(Slot& slot) {
+    vertexAllocator.free(slot.range.firstVertex, slot.range.vertexCount);
+    indexAllocator.free(slot.range.firstIndex, slot.range.indexCount);
+    slot.range = {};
+}
+
+void GeometryBuffer::update(const std::vector<Object*>& objects, uint64_t sceneRevision, uint32_t frame) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    Region& region = regions[frame];
+
+    updatesCount++;
+    uploadedBytes = 0;
+    rewrittenObjects = 0;
+
+    ranges.resize(objects.size());
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        Object* pObject = objects[i];
+        uint64_t revision = pObject->getGeometryRevision();
+
+        Slot& slot = slots[pObject->getId()];
+        if (slot.regionRevisions.empty()) slot.regionRevisions.resize(framesInFlight, 0);
+        slot.seenUpdate = updatesCount;
+
+        if (slot.regionRevisions[frame] != revision) {
+            std::vector<Vertex> vertices = pObject->getVertices();
+            std::vector<uint32_t> indices = pObject->getIndices();
+
+            if (slot.revision != revision) {
+                // new or resized geometry moves to a new allocation, every region rewrites it
+                if (slot.revision == 0 || vertices.size() != slot.range.vertexCount || indices.size() != slot.range.indexCount) {
+                    free(slot);
+                    allocate(slot, (uint32_t)vertices.size(), (uint32_t)indices.size());
+                    std::fill(slot.regionRevisions.begin(), slot.regionRevisions.end(), 0);
+                }
+
+                for (uint32_t index : indices) {
+                    if (index > UINT16_MAX) indexType = VK_INDEX_TYPE_UINT32;
+                }
+
+                slot.revision = revision;
+            }
+
+            // the arena may have grown or widened since this region was last updated
+            fitRegion(region);
+
+            memcpy(region.pVertices + slot.range.firstVertex, vertices.data(), vertices.size() * sizeof(Vertex));
+
+            if (region.indexType == VK_INDEX_TYPE_UINT32) {
+                memcpy((uint32_t*)region.pIndices + slot.range.firstIndex, indices.data(), indices.size() * sizeof(uint32_t));
+            }
+            else {
+                uint16_t* pIndices = (uint16_t*)region.pIndices + slot.range.firstIndex;
+                for (size_t j = 0; j < indices.size(); j++) {
+                    pIndices[j] = (uint16_t)indices[j];
+                }
+            }
+
+            slot.regionRevisions[frame] = revision;
+
+            uploadedBytes += vertices.size() * sizeof(Vertex) + indices.size() * getIndexSize(region.indexType);
+            rewrittenObjects++;
+        }
+
+        ranges[i] = slot.range;
+    }
+
+    // release the allocations of removed objects
+    if (GeometryBuffer::sceneRevision != sceneRevision) {
+        for (auto slotIt = slots.begin(); slotIt != slots.end();) {
+            if (slotIt->second.seenUpdate != updatesCount) {
+                free(slotIt->second);
+                slotIt = slots.erase(slotIt);
+            }
+            else {
+                slotIt++;
+            }
+        }
+
+        GeometryBuffer::sceneRevision = sceneRevision;
+    }
+
+    updateSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint64_t GeometryBuffer::getCapacityBytes() {
+    return (uint64_t)vertexAllocator.getCapacity() * sizeof(Vertex) + (uint64_t)indexAllocator.getCapacity() * getIndexSize(indexType);
+}
+
+uint64_t GeometryBuffer::getUsedBytes() {
+    return (uint64_t)vertexAllocator.getUsed() * sizeof(Vertex) + (uint64_t)indexAllocator.getUsed() * getIndexSize(indexType);
+}
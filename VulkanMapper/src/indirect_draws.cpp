@@ -0,0 +1,110 @@
+#include "../include/indirect_draws.h"
+#include "../include/vk_state.h"
+#include "../include/scene_objects.h"
+#include "../include/draw_list.h"
+#include "../include/geometry_buffer.h"
+
+#include <algorithm>
+
+IndirectDraws::IndirectDraws(VulkanState* pVkState, const std::vector<VkDescriptorSet>& descriptorSets, uint32_t capacity) {
+    IndirectDraws::pVkState = pVkState;
+
+    regions.resize(descriptorSets.size());
+    for (size_t i = 0; i < regions.size(); i++) {
+        regions[i].descriptorSet = descriptorSets[i];
+        fitRegion(regions[i], capacity);
+    }
+}
+
+IndirectDraws::~IndirectDraws() {
+    for (auto& region : regions) {
+        destroyRegion(region);
+    }
+}
+
+void IndirectDraws::destroyRegion(Region& region) {
+    VkDevice device = pVkState->getDevice();
+
+    vkUnmapMemory(device, region.commandMemory);
+    vkDestroyBuffer(device, region.commandBuffer, nullptr);
+    vkFreeMemory(device, region.commandMemory, nullptr);
+
+    vkUnmapMemory(device, region.instanceMemory);
+    vkDestroyBuffer(device, region.instanceBuffer, nullptr);
+    vkFreeMemory(device, region.instanceMemory, nullptr);
+}
+
+void IndirectDraws::fitRegion(Region& region, uint32_t count) {
+    if (count <= region.capacity) return;
+
+    VkDevice device = pVkState->getDevice();
+
+    if (region.commandBuffer != VK_NULL_HANDLE) destroyRegion(region);
+
+    uint32_t capacity = std::max(count, region.capacity * 2);
+
+    // host visible and mapped once, read by the draw commands directly
+    VkDeviceSize commandBytes = sizeof(VkDrawIndexedIndirectCommand) * capacity;
+    pVkState->createBuffer(commandBytes, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, region.commandBuffer, region.commandMemory, nullptr);
+    vkMapMemory(device, region.commandMemory, 0, commandBytes, 0, (void**)&region.pCommands);
+
+    VkDeviceSize instanceBytes = sizeof(InstanceData) * capacity;
+    pVkState->createBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, region.instanceBuffer, region.instanceMemory, nullptr);
+    vkMapMemory(device, region.instanceMemory, 0, instanceBytes, 0, (void**)&region.pInstances);
+
+    region.capacity = capacity;
+
+    // the set isn't in flight with the frame, only rewritten when the buffer grows
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = region.instanceBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = region.descriptorSet;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void IndirectDraws::update(const std::vector<Object*>& objects, DrawList* pDrawList, GeometryBuffer* pGeometry, uint32_t frame) {
+    Region& region = regions[frame];
+
+    auto& packets = pDrawList->getPackets();
+    auto& ranges = pGeometry->getRanges();
+
+    fitRegion(region, (uint32_t)packets.size());
+
+    for (uint32_t i = 0; i < packets.size(); i++) {
+        const DrawPacket& packet = packets[i];
+        const GeometryRange& range = ranges[packet.objectIndex];
+
+        VkDrawIndexedIndirectCommand& command = region.pCommands[i];
+        command.indexCount = range.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = range.firstIndex;
+        command.vertexOffset = (int32_t)range.firstVertex;
+        command.firstInstance = i;
+
+        Object* pObject = objects[packet.objectIndex];
+        region.pInstances[i].tint = glm::vec4(pObject->getTint(), 0.0f);
+        region.pInstances[i].textureIndex = pObject->getTextureIndex();
+    }
+
+    batchPackets(packets, batches);
+}
+
+void IndirectDraws::record(VkCommandBuffer commandBuffer, const DrawBatch& batch, uint32_t frame) {
+    vkCmdDrawIndexedIndirect(
+        commandBuffer,
+        regions[frame].commandBuffer,
+        sizeof(VkDrawIndexedIndirectCommand) * batch.firstCommand,
+        batch.commandCount,
+        sizeof(VkDrawIndexedIndirectCommand)
+    );
+}
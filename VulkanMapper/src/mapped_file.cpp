@@ -0,0 +1,107 @@
+#include "../include/mapped_file.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filePath) {
+#ifdef _WIN32
+    fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("failed to open file!");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        CloseHandle(fileHandle);
+        throw std::runtime_error("failed to get file size!");
+    }
+    size = (size_t)fileSize.QuadPart;
+
+    if (size == 0) return;  // empty files can't be mapped
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        CloseHandle(fileHandle);
+        throw std::runtime_error("failed to map file!");
+    }
+
+    pData = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (pData == nullptr) {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("failed to map file!");
+    }
+#else
+    fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        close(fileDescriptor);
+        throw std::runtime_error("failed to get file size!");
+    }
+    size = (size_t)fileStat.st_size;
+
+    if (size == 0) return;  // empty files can't be mapped
+
+    void* pMapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (pMapping == MAP_FAILED) {
+        close(fileDescriptor);
+        throw std::runtime_error("failed to map file!");
+    }
+
+    // samples are read front to back
+    madvise(pMapping, size, MADV_SEQUENTIAL);
+
+    pData = (const uint8_t*)pMapping;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (pData != nullptr) UnmapViewOfFile(pData);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != nullptr) CloseHandle(fileHandle);
+#else
+    if (pData != nullptr) munmap((void*)pData, size);
+    if (fileDescriptor >= 0) close(fileDescriptor);
+#endif
+}
+
+int mappedFileRead(int64_t offset, void* buffer, size_t size, void* token) {
+    MappedFile* pFile = (MappedFile*)token;
+    if (offset < 0 || (uint64_t)offset >= pFile->getSize()) return 1;
+
+    size_t toCopy = std::min(size, pFile->getSize() - (size_t)offset);
+    std::memcpy(buffer, pFile->data() + offset, toCopy);
+    return toCopy != size;
+}
+
+uint64_t queryPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (uint64_t)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (uint64_t)usage.ru_maxrss * 1024;   // kilobytes on linux
+#endif
+}
@@ -0,0 +1,36 @@
+#include "../include/master_clock.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+MasterClock::MasterClock() {
+    origin = std::chrono::steady_clock::now();
+}
+
+int64_t MasterClock::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+std::chrono::steady_clock::time_point MasterClock::toTimePoint(int64_t masterTime) {
+    return origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(masterTime));
+}
+
+int64_t rescaleTime(int64_t value, int64_t from, int64_t to) {
+    // the quotient and remainder truncate toward zero
+#if defined(_MSC_VER) && !defined(__clang__)
+    int64_t productHigh;
+    int64_t productLow = _mul128(value, to, &productHigh);
+    int64_t remainder;
+    int64_t quotient = _div128(productHigh, productLow, from, &remainder);
+#else
+    __int128 product = (__int128)value * to;
+    int64_t quotient = (int64_t)(product / from);
+    int64_t remainder = (int64_t)(product % from);
+#endif
+
+    // floor, an inexact negative quotient steps down
+    if (remainder != 0 && (remainder < 0) != (from < 0)) quotient--;
+
+    return quotient;
+}
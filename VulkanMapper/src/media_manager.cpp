@@ -11,17 +11,42 @@
 
 MediaManager::MediaManager(App* pApp) {
     MediaManager::pApp = pApp;
+    pLoadPool = new ThreadPool();
+}
+
+void MediaManager::init() {
+    decodeRunning = true;
+    decodeThread = std::thread(&MediaManager::decodeLoop, this);
 }
 
 void MediaManager::loadFile(std::string filePath) {
     std::string fileExtension = filePath.substr(filePath.find_last_of(".") + 1);
 
+    PendingMedia* pPending = new PendingMedia();
+    pPending->id = newId();
+    pPending->filePath = filePath;
+
+    VulkanState* pVkState = pApp->getVulkanState();
+    ThreadPool* pPool = pLoadPool;
+    MasterClock* pMasterClock = &masterClock;
+    ReadyFrameQueue* pReadyFrames = &readyFrames;
+
     if (fileExtension == "mp4") {
-        medias.push_back(new Video(newId(), pApp->getVulkanState(), filePath));
+        pPending->result = pLoadPool->submit([pPending, pVkState, pMasterClock, pReadyFrames, pPool]() -> Media* {
+            return new Video(pPending->id, pVkState, pMasterClock, pReadyFrames, pPending->filePath, &pPending->progress, pPool);
+        });
     }
     else if (fileExtension == "jpg" || fileExtension == "png") {
-        medias.push_back(new Image(newId(), pApp->getVulkanState(), filePath));
+        pPending->result = pLoadPool->submit([pPending, pVkState]() -> Media* {
+            return new Image(pPending->id, pVkState, pPending->filePath, &pPending->progress);
+        });
     }
+    else {
+        delete pPending;
+        return;
+    }
+
+    pendingMedias.push_back(pPending);
 }
 
 MediaId_t MediaManager::newId() {
@@ -33,26 +58,73 @@ MediaId_t MediaManager::newId() {
             newId = media->getId() + 1;
         }
     }
+    for (auto pPending : pendingMedias) {
+        if (pPending->id >= newId) {
+            newId = pPending->id + 1;
+        }
+    }
+    // frames of removed videos may still be queued under their id
+    for (auto pVideo : retiringVideos) {
+        if (pVideo->getId() >= newId) {
+            newId = pVideo->getId() + 1;
+        }
+    }
 
     return newId;
 }
 
 void MediaManager::updateMedia() {
-    // video decode
+    // decode errors end the app as they did on the main thread
+    if (!decodeRunning && decodeError) std::rethrow_exception(decodeError);
+
+    // publish loaded media, a video reaches the decode thread once uploaded
+    for (size_t i = 0; i < pendingMedias.size();) {
+        PendingMedia* pPending = pendingMedias[i];
+
+        if (pPending->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            i++;
+            continue;   // still loading
+        }
+
+        Media* pMedia = nullptr;
+        try {
+            pMedia = pPending->result.get();
+            pMedia->upload();
+            medias.push_back(pMedia);
+
+            if (auto pVideo = dynamic_cast<Video*>(pMedia)) handOffVideo(addedVideos, pVideo);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "failed to load " << pPending->filePath << ": " << e.what() << std::endl;
+            delete pMedia;
+        }
+
+        delete pPending;
+        pendingMedias.erase(pendingMedias.begin() + i);
+    }
+
+    // media sampled by the scene (and the outputs rendering it)
+    std::vector<MediaId_t> visibleMediaIds;
+    for (auto pObject : pApp->getScene()->getObjects()) {
+        if (auto pPlane = dynamic_cast<Plane*>(pObject)) {
+            visibleMediaIds.push_back(pPlane->getMediaId());
+        }
+    }
+
+    // hidden videos are idle on the decode thread, which picks the change up on its next tick
     for (auto media : medias) {
         if (auto pVideo = dynamic_cast<Video*>(media)) {   // VIDEO
-            pVideo->decodeFrame();
+            bool visible = std::find(visibleMediaIds.begin(), visibleMediaIds.end(), pVideo->getId()) != visibleMediaIds.end();
+            pVideo->setVisible(visible);
         }
     }
 
-    // remove media
+    // remove media, a video is destroyed once the decode thread released it
     for (auto mediaId : toRemove) {
         for (int i = 0; i < medias.size(); i++) {
             if (medias[i]->getId() == mediaId) {
                 // clear objects using this media
-                std::vector<uint8_t> objectsIds = pApp->getScene()->getIds();
-                for (auto objectId : objectsIds) {
-                    auto pObject = pApp->getScene()->getObjectPointer(objectId);
+                for (auto pObject : pApp->getScene()->getObjects()) {
                     if (auto pPlane = dynamic_cast<Plane*>(pObject)) {
                         if (pPlane->getMediaId() == mediaId) {
                             pPlane->setMediaId(-1);
@@ -60,12 +132,109 @@ void MediaManager::updateMedia() {
                     }
                 }
 
-                delete medias[i];
+                if (auto pVideo = dynamic_cast<Video*>(medias[i])) {
+                    handOffVideo(removingVideos, pVideo);
+                    retiringVideos.push_back(pVideo);
+                }
+                else {
+                    delete medias[i];
+                }
                 medias.erase(medias.begin() + i);
             }
         }
     }
     if (toRemove.size() > 0) toRemove.clear();
+
+    // only the main thread changes medias, no lock needed to look them up
+    showReadyFrames();
+
+    // frames a released video queued before its release are drained first (dropped, it's not in medias anymore),
+    // its id and frame stream can then be reused
+    Video* pReleased;
+    while (releasedVideos.pop(pReleased)) {
+        showReadyFrames();
+        retiringVideos.erase(std::find(retiringVideos.begin(), retiringVideos.end(), pReleased));
+        delete pReleased;
+    }
+}
+
+void MediaManager::handOffVideo(SpscQueue<Video*>& queue, Video* pVideo) {
+    // one entry per media id at most, the queues can't fill up
+    if (!queue.push(pVideo)) {
+        throw std::runtime_error("failed to hand off video to the decode thread!");
+    }
+}
+
+void MediaManager::showReadyFrames() {
+    // newest frame of each video, older ones were superseded before being drawn
+    newestFrames.clear();
+    ReadyFrame readyFrame;
+    while (readyFrames.pop(readyFrame)) {
+        auto frameIt = std::find_if(newestFrames.begin(), newestFrames.end(), [&readyFrame](const ReadyFrame& newestFrame) {
+            return newestFrame.mediaId == readyFrame.mediaId;
+            });
+        if (frameIt != newestFrames.end()) *frameIt = readyFrame;
+        else newestFrames.push_back(readyFrame);
+    }
+
+    for (const ReadyFrame& newestFrame : newestFrames) {
+        Video* pVideo = dynamic_cast<Video*>(getMediaById(newestFrame.mediaId));
+        if (pVideo == nullptr) continue;
+
+        pApp->getVulkanState()->loadVideoFrame(newestFrame.streamId, newestFrame.frame);
+        pVideo->setShownSequence(newestFrame.sequence);     // frames before it can be reused
+    }
+}
+
+void MediaManager::decodeLoop() {
+    DecodeScheduler* pDecodeScheduler = pApp->getVulkanState()->getDecodeScheduler();
+
+    try {
+        while (decodeRunning) {
+            // videos loaded and removed by the main thread
+            Video* pVideo;
+            while (addedVideos.pop(pVideo)) decodeVideos.push_back(pVideo);
+            while (removingVideos.pop(pVideo)) {
+                decodeVideos.erase(std::find(decodeVideos.begin(), decodeVideos.end(), pVideo));
+                handOffVideo(releasedVideos, pVideo);
+            }
+
+            // wake up at the next presentation, or soon enough to pick up control changes
+            std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point wakeTime = currentTime + std::chrono::milliseconds(DECODE_THREAD_MAX_WAIT_MS);
+
+            // the lock only guards playback state against ui controls, nothing in the tick blocks on the device
+            {
+                std::lock_guard<std::mutex> lock(mediaMutex);
+
+                // the decodes of all videos go to the video queue in one submit
+                // hidden and paused videos are idle and keep their last frame
+                if (pDecodeScheduler != nullptr) pDecodeScheduler->beginTick();
+                for (auto pVideo : decodeVideos) {
+                    pVideo->updateVisibility();
+                    if (pVideo->isIdle()) continue;
+
+                    pVideo->decodeFrame();
+
+                    // a past deadline waits on its decode
+                    std::chrono::steady_clock::time_point deadline = pVideo->getNextDeadline();
+                    if (deadline > currentTime) wakeTime = std::min(wakeTime, deadline);
+                }
+            }
+
+            // the scheduler is only used by this thread
+            if (pDecodeScheduler != nullptr) pDecodeScheduler->submit();
+
+            // block on the decode timeline, the cpu backend has nothing to wait on
+            if (pDecodeScheduler == nullptr || !pDecodeScheduler->waitNext(wakeTime)) {
+                std::this_thread::sleep_until(wakeTime);
+            }
+        }
+    }
+    catch (...) {
+        decodeError = std::current_exception();
+        decodeRunning = false;
+    }
 }
 
 std::vector<MediaId_t> MediaManager::getMediasIds() {
@@ -92,8 +261,39 @@ void MediaManager::removeMedia(MediaId_t mediaId) {
     toRemove.push_back(mediaId);
 }
 
+void MediaManager::playAll() {
+    std::lock_guard<std::mutex> lock(mediaMutex);
+
+    // one anchor for all, the clips then stay in step
+    int64_t masterTime = masterClock.now();
+    for (auto pMedia : medias) {
+        if (auto pVideo = dynamic_cast<Video*>(pMedia)) {
+            pVideo->firstFrame();
+            pVideo->playAt(masterTime);
+        }
+    }
+}
+
 void MediaManager::cleanup() {
+    // stop decoding first, the videos are destroyed below
+    decodeRunning = false;
+    if (decodeThread.joinable()) decodeThread.join();
+
+    // wait for the loaders
+    for (auto pPending : pendingMedias) {
+        try {
+            delete pPending->result.get();
+        }
+        catch (const std::exception&) {}
+        delete pPending;
+    }
+    pendingMedias.clear();
+    delete pLoadPool;
+
     for (auto media : medias) {
         delete media;
     }
+    for (auto pVideo : retiringVideos) {
+        delete pVideo;
+    }
 }
@@ -0,0 +1,67 @@
+#include "../include/range_allocator.h"
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    RangeAllocator::capacity = capacity;
+    if (capacity > 0) freeRanges.push_back({ 0, capacity });
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t& offset) {
+    if (count == 0) {
+        offset = 0;
+        return true;
+    }
+
+    for (uint32_t i = 0; i < freeRanges.size(); i++) {
+        FreeRange& freeRange = freeRanges[i];
+        if (freeRange.count < count) continue;
+
+        offset = freeRange.offset;
+        freeRange.offset += count;
+        freeRange.count -= count;
+        if (freeRange.count == 0) freeRanges.erase(freeRanges.begin() + i);
+
+        used += count;
+        return true;
+    }
+
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+    if (count == 0) return;
+
+    // first free range after the freed one
+    uint32_t nextRange = 0;
+    while (nextRange < freeRanges.size() && freeRanges[nextRange].offset < offset) nextRange++;
+
+    bool mergePrev = nextRange > 0 && freeRanges[nextRange - 1].offset + freeRanges[nextRange - 1].count == offset;
+    bool mergeNext = nextRange < freeRanges.size() && offset + count == freeRanges[nextRange].offset;
+
+    if (mergePrev && mergeNext) {
+        freeRanges[nextRange - 1].count += count + freeRanges[nextRange].count;
+        freeRanges.erase(freeRanges.begin() + nextRange);
+    }
+    else if (mergePrev) {
+        freeRanges[nextRange - 1].count += count;
+    }
+    else if (mergeNext) {
+        freeRanges[nextRange].offset = offset;
+        freeRanges[nextRange].count += count;
+    }
+    else {
+        freeRanges.insert(freeRanges.begin() + nextRange, { offset, count });
+    }
+
+    used -= count;
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    if (capacity <= RangeAllocator::capacity) return;
+
+    uint32_t oldCapacity = RangeAllocator::capacity;
+    RangeAllocator::capacity = capacity;
+
+    // the new tail is free
+    used += capacity - oldCapacity;
+    free(oldCapacity, capacity - oldCapacity);
+}
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
 
@@ -10,25 +11,18 @@ Scene::Scene(App* pApp) {
 	Scene::pApp = pApp;
 }
 
-uint8_t Scene::addObject(Object* object_ptr) {
-	uint8_t new_id = 0;
-
-	for (Object* object : pObjects) {
-		uint8_t object_id = object->getId();
-
-		if (object_id >= new_id) {
-			new_id = object_id + 1;
-		}
-	}
+ObjectId_t Scene::addObject(Object* object_ptr) {
+	ObjectId_t new_id = nextObjectId++;
 
 	object_ptr->setId(new_id);
 
 	pObjects.push_back(object_ptr);
+	revision++;
 
 	return new_id;
 }
 
-void Scene::removeObject(uint8_t object_id) {
+void Scene::removeObject(ObjectId_t object_id) {
 	for (Object* object_ptr : pObjects) {
 		if (object_ptr->getId() == object_id) {
 			object_ptr->beforeRemove();
@@ -42,21 +36,22 @@ void Scene::removeObject(uint8_t object_id) {
 			}
 
 			delete object_ptr;
+			revision++;
 			return;
 		}
 	}
 	std::cout << "object with id " << object_id << " not found" << std::endl;
 }
 
-Object* Scene::getObjectPointer(uint8_t object_id) {
+Object* Scene::getObjectPointer(ObjectId_t object_id) {
 	for (Object* object : pObjects) {
 		if (object->getId() == object_id) return object;
 	}
 	return nullptr;
 }
 
-std::vector<uint8_t> Scene::getIds() {
-	std::vector<uint8_t> ids;
+std::vector<ObjectId_t> Scene::getIds() {
+	std::vector<ObjectId_t> ids;
 
 	for (Object* object_ptr : pObjects) {
 		ids.push_back(object_ptr->getId());
@@ -102,41 +97,49 @@ void Scene::mouseRayCallback(glm::vec4 mouseRay) {
 	// check if cursor is hovering an object
 	int new_hovering_obj_id = -1; // reset
 
-	for (int o = pObjects.size() - 1; o >= 0; o--) {
-		std::vector<Vertex> vertices = pObjects[o]->getVertices();
-		std::vector<uint16_t> indices = pObjects[o]->getIndices();
-		
-		if (new_hovering_obj_id >= 0) break;
-
-		// skip if line
-		if (pObjects[o]->getPipelineName() != "line") {
-			for (int i = 0; i < indices.size(); i += 3) {
-				std::vector<glm::vec2> triangle;
-				triangle.resize(3);
-
-				for (int j = 0; j < 3; j++) {
-					auto vertex_normal = glm::normalize(vertices[indices[i + j]].pos);
-					float flat_t = -1 / vertex_normal.z;
-					triangle[j] = glm::vec2({ vertex_normal.x * flat_t, vertex_normal.y * flat_t });
-				}
+	// topmost first, as drawn: higher layers over lower ones, later objects over earlier ones in a layer
+	uint8_t topLayer = 0;
+	for (Object* pObject : pObjects) topLayer = std::max(topLayer, pObject->getDrawLayer());
+
+	for (int layer = topLayer; layer >= 0 && new_hovering_obj_id < 0; layer--) {
+		for (int o = pObjects.size() - 1; o >= 0; o--) {
+			if (pObjects[o]->getDrawLayer() != layer) continue;
 
-				// Cursor is hovering obj
-				if (pointInsideTriangle(
-					glm::vec2({ mouseWorldX, mouseWorldY }),
-					triangle
-				)) {
-					// invoke object hover enter event
-					if (pObjects[o]->getId() != hoveringObjId) {
-						pObjects[o]->hoveringStart();
+			std::vector<Vertex> vertices = pObjects[o]->getVertices();
+			std::vector<uint32_t> indices = pObjects[o]->getIndices();
+		
+			if (new_hovering_obj_id >= 0) break;
+
+			// skip if line
+			if (pObjects[o]->getPipelineId() != LinePipeline) {
+				for (int i = 0; i < indices.size(); i += 3) {
+					std::vector<glm::vec2> triangle;
+					triangle.resize(3);
+
+					for (int j = 0; j < 3; j++) {
+						auto vertex_normal = glm::normalize(vertices[indices[i + j]].pos);
+						float flat_t = -1 / vertex_normal.z;
+						triangle[j] = glm::vec2({ vertex_normal.x * flat_t, vertex_normal.y * flat_t });
 					}
 
-					new_hovering_obj_id = pObjects[o]->getId();
-					break;
+					// Cursor is hovering obj
+					if (pointInsideTriangle(
+						glm::vec2({ mouseWorldX, mouseWorldY }),
+						triangle
+					)) {
+						// invoke object hover enter event
+						if (pObjects[o]->getId() != hoveringObjId) {
+							pObjects[o]->hoveringStart();
+						}
+
+						new_hovering_obj_id = pObjects[o]->getId();
+						break;
+					}
 				}
 			}
-		}
 
 		
+		}
 	}
 
 	// invoke object hover leave event
@@ -6,7 +6,7 @@
 #include "../include/image.h"
 
 // Rect
-Marker::Marker(Scene* scene_ptr, float pos_x, float pos_y, glm::vec3 color, uint8_t parent_id, uint16_t vertex_id) {
+Marker::Marker(Scene* scene_ptr, float pos_x, float pos_y, glm::vec3 color, ObjectId_t parent_id, uint16_t vertex_id) {
     Marker::pos_x = pos_x;
     Marker::pos_y = pos_y;
     Marker::color = color;
@@ -16,23 +16,16 @@ Marker::Marker(Scene* scene_ptr, float pos_x, float pos_y, glm::vec3 color, uint
 }
 
 std::vector<Vertex> Marker::getVertices() {
-    glm::vec3 finalColor = color;
-    
-    if (highlighted) {
-        finalColor.r += .2f;
-        finalColor.g += .2f;
-        finalColor.b += .2f;
-    }
-
+    // the highlight is a tint
     return {
-        {{ -Marker::dimension / 2 + Marker::pos_x, -Marker::dimension / 2 + Marker::pos_y, -1.0f }, finalColor, {1.0f, 0.0f}},
-        {{ Marker::dimension / 2 + Marker::pos_x, -Marker::dimension / 2 + Marker::pos_y, -1.0f}, finalColor, {0.0f, 0.0f}},
-        {{ Marker::dimension / 2 + Marker::pos_x, Marker::dimension / 2 + Marker::pos_y, -1.0f}, finalColor, {0.0f, 1.0f}},
-        {{ -Marker::dimension / 2 + Marker::pos_x, Marker::dimension / 2 + Marker::pos_y, -1.0f}, finalColor, {1.0f, 1.0f}}
+        {{ -Marker::dimension / 2 + Marker::pos_x, -Marker::dimension / 2 + Marker::pos_y, -1.0f }, color, {1.0f, 0.0f}},
+        {{ Marker::dimension / 2 + Marker::pos_x, -Marker::dimension / 2 + Marker::pos_y, -1.0f}, color, {0.0f, 0.0f}},
+        {{ Marker::dimension / 2 + Marker::pos_x, Marker::dimension / 2 + Marker::pos_y, -1.0f}, color, {0.0f, 1.0f}},
+        {{ -Marker::dimension / 2 + Marker::pos_x, Marker::dimension / 2 + Marker::pos_y, -1.0f}, color, {1.0f, 1.0f}}
     };
 }
 
-std::vector<uint16_t> Marker::getIndices() {
+std::vector<uint32_t> Marker::getIndices() {
     return {
         0, 1, 2, 2, 3, 0
     };
@@ -63,6 +56,7 @@ uint16_t Marker::get_vertex_id() {
 void Marker::onMove(float deltaX, float deltaY) {
     Marker::pos_x += deltaX;
     Marker::pos_y += deltaY;
+    geometryChanged();
 
     Plane* parent = dynamic_cast<Plane*>(scene_ptr->getObjectPointer(parent_id));
     
@@ -98,24 +92,25 @@ std::vector<Vertex> Plane::getVertices() {
     return vertices;
 }
 
-std::vector<uint16_t> Plane::getIndices() {
+std::vector<uint32_t> Plane::getIndices() {
     return {
         0, 1, 2, 2, 3, 0
     };
 }
 
-std::string Plane::getPipelineName() {
+void Plane::setMediaId(int id) {
+    Plane::mediaId = id;
+
+    // the media type never changes, resolved once instead of every frame
+    pipelineId = ColorPipeline;
     if (mediaId != -1) {
         Media* pMedia = pApp->getMediaManager()->getMediaById(mediaId);
-        if (dynamic_cast<Image*>(pMedia) != nullptr) { return "texture"; }
-        if (dynamic_cast<Video*>(pMedia) != nullptr) { return "video_frame"; }
+        if (Image* pImage = dynamic_cast<Image*>(pMedia)) {
+            pipelineId = TexturePipeline;
+            textureIndex = pImage->getTextureId();
+        }
+        if (dynamic_cast<Video*>(pMedia) != nullptr) pipelineId = VideoFramePipeline;
     }
-
-    return "color";
-}
-
-void Plane::setMediaId(int id) {
-    Plane::mediaId = id;
 }
 
 void Plane::hoveringStart() {
@@ -125,11 +120,7 @@ void Plane::hoveringStop() {
 }
 
 void Plane::onSelect() {
-    for (auto& vertex : vertices) {
-        vertex.color.r += .1f;
-        vertex.color.g += .1f;
-        vertex.color.b += .1f;
-    }
+    selected = true;
 
     // add marker
     for (int i = 0; i < vertices.size(); i++) {
@@ -151,11 +142,7 @@ void Plane::onSelect() {
 }
 
 void Plane::onRelease() {
-    for (auto& vertex : vertices) {
-        vertex.color.r -= .1f;
-        vertex.color.g -= .1f;
-        vertex.color.b -= .1f;
-    }
+    selected = false;
     
     // remove markers
     for (auto marker_id : markerIds) {
@@ -359,6 +346,7 @@ void Plane::moveVertex(unsigned int vertex_id) {
     for (int i = 0; i < vertices_count; i++) {
         vertices[i].pos = source[i] * H;
     }
+    geometryChanged();
 
     // move line
     for (int i = 0; i < 4; i++) {
@@ -384,7 +372,7 @@ std::vector<Vertex> Line::getVertices() {
     return vertices;
 }
 
-std::vector<uint16_t> Line::getIndices() {
+std::vector<uint32_t> Line::getIndices() {
     return { 0, 1 };
 }
 
@@ -393,4 +381,5 @@ void Line::moveVertices(glm::vec2 firstPoint, glm::vec2 secondPoint) {
         Vertex{{ firstPoint.x, firstPoint.y, -1.0f }, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f} },
         Vertex{{ secondPoint.x, secondPoint.y, -1.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f} },
     };
+    geometryChanged();
 }
@@ -0,0 +1,112 @@
+#include "../include/slice_parser.h"
+
+#include <cassert>
+#include <h264.h>
+
+// parses the frames of one gop, returns the poc cycles in it
+static int parseGop(FrameTable& frames, const SliceTable& slices, const uint8_t* fileData, const h264::SPS* spsArray, const h264::PPS* ppsArray, uint32_t firstFrame, uint32_t lastFrame) {
+    // poc msb tracking restarts at every idr, prevPicOrderCntMsb and prevPicOrderCntLsb are 0 for an idr picture
+    // Rec. ITU-T H.264 (08/2021) 8.2.1.1, it's what makes the gops independent
+    int prevPicOrderCntLSB = 0;
+    int prevPicOrderCntMSB = 0;
+    int pocCycle = 0;
+
+    for (uint32_t i = firstFrame; i < lastFrame; i++) {
+        if (frames.sliceCount[i] == 0) continue;   // no slice in this sample
+
+        // the slices of a picture share the fields kept, the first one is read
+        uint32_t slice = frames.firstSlice[i];
+        const uint8_t* srcBuffer = fileData + slices.fileOffset[slice];
+        uint64_t nalSize = slices.size[slice] - sizeof(h264::nal_start_code);
+
+        h264::Bitstream bs = {};
+        bs.init(srcBuffer, nalSize);
+        h264::NALHeader nal = {};
+        h264::read_nal_header(&nal, &bs);
+
+        h264::SliceHeader sliceHeader = {};
+        h264::read_slice_header(&sliceHeader, &nal, ppsArray, spsArray, &bs);
+
+        // keep only the fields needed for decode
+        frames.ppsId[i] = (uint8_t)sliceHeader.pic_parameter_set_id;
+        frames.frameNum[i] = (uint16_t)sliceHeader.frame_num;
+        frames.idrPicId[i] = (uint16_t)sliceHeader.idr_pic_id;
+        frames.fieldFlags[i] =
+            (sliceHeader.field_pic_flag ? FRAME_FIELD_PIC_FLAG : 0) |
+            (sliceHeader.bottom_field_flag ? FRAME_BOTTOM_FIELD_FLAG : 0);
+
+        const h264::PPS& pps = ppsArray[sliceHeader.pic_parameter_set_id];
+        const h264::SPS& sps = spsArray[pps.seq_parameter_set_id];
+
+        // Rec. ITU-T H.264 (08/2021) page 77
+        int maxPicOrderCntLSB = 1 << (sps.log2_max_pic_order_cnt_lsb_minus4 + 4);
+        int picOrderCntLSB = sliceHeader.pic_order_cnt_lsb;
+
+        if (frames.type[i] == FrameType::IntraFrame) {
+            prevPicOrderCntLSB = 0;
+            prevPicOrderCntMSB = 0;
+        }
+
+        if (picOrderCntLSB == 0) {
+            pocCycle++;
+        }
+
+        // Rec. ITU-T H.264 (08/2021) page 115
+        // Also: https://www.ramugedia.com/negative-pocs
+        int picOrderCntMSB = 0;
+        if (picOrderCntLSB < prevPicOrderCntLSB && (prevPicOrderCntLSB - picOrderCntLSB) >= maxPicOrderCntLSB / 2) {
+            picOrderCntMSB = prevPicOrderCntMSB + maxPicOrderCntLSB; // pic_order_cnt_lsb wrapped around
+        }
+        else if (picOrderCntLSB > prevPicOrderCntLSB && (picOrderCntLSB - prevPicOrderCntLSB) > maxPicOrderCntLSB / 2) {
+            picOrderCntMSB = prevPicOrderCntMSB - maxPicOrderCntLSB; // here negative POC might occur
+        }
+        else {
+            picOrderCntMSB = prevPicOrderCntMSB;
+        }
+        prevPicOrderCntLSB = picOrderCntLSB;
+        prevPicOrderCntMSB = picOrderCntMSB;
+
+        // https://www.vcodex.com/h264avc-picture-management/
+        frames.poc[i] = picOrderCntMSB + picOrderCntLSB;   // poc = TopFieldOrderCount
+        frames.gop[i] = pocCycle - 1;                       // local to the gop, stitched by the caller
+    }
+
+    return pocCycle;
+}
+
+void parseSliceHeaders(FrameTable& frames, const SliceTable& slices, const uint8_t* fileData, const std::vector<uint8_t>& spsData, const std::vector<uint8_t>& ppsData, ThreadPool* pParsePool, std::atomic<uint32_t>* pFramesIndexed) {
+    const h264::SPS* spsArray = (const h264::SPS*)spsData.data();
+    const h264::PPS* ppsArray = (const h264::PPS*)ppsData.data();
+
+    // split the track at idr frames
+    std::vector<uint32_t> gopStarts;
+    for (uint32_t i = 0; i < frames.count; i++) {
+        if (i == 0 || frames.type[i] == FrameType::IntraFrame) gopStarts.push_back(i);
+    }
+
+    std::vector<int> gopPocCycles(gopStarts.size());
+    auto parseGopAt = [&](uint32_t gopIndex) {
+        uint32_t first = gopStarts[gopIndex];
+        uint32_t last = gopIndex + 1 < gopStarts.size() ? gopStarts[gopIndex + 1] : frames.count;
+        gopPocCycles[gopIndex] = parseGop(frames, slices, fileData, spsArray, ppsArray, first, last);
+        if (pFramesIndexed != nullptr) *pFramesIndexed += last - first;
+    };
+
+    if (pParsePool != nullptr) {
+        pParsePool->parallelFor((uint32_t)gopStarts.size(), parseGopAt);
+    }
+    else {
+        for (uint32_t i = 0; i < gopStarts.size(); i++) parseGopAt(i);
+    }
+
+    // stitch gop numbering, local cycles are offset by the cycles of the previous gops
+    int pocCycleOffset = 0;
+    for (uint32_t gopIndex = 0; gopIndex < gopStarts.size(); gopIndex++) {
+        uint32_t first = gopStarts[gopIndex];
+        uint32_t last = gopIndex + 1 < gopStarts.size() ? gopStarts[gopIndex + 1] : frames.count;
+        for (uint32_t i = first; i < last; i++) {
+            frames.gop[i] += pocCycleOffset;
+        }
+        pocCycleOffset += gopPocCycles[gopIndex];
+    }
+}
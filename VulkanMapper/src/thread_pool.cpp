@@ -0,0 +1,99 @@
+#include "../include/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksCondition.notify_all();
+
+    // queued tasks are drained before the workers exit
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            tasksCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task) {
+    if (count == 0) return;
+
+    // shared with helpers that may start after the caller returned
+    struct ParallelForState {
+        std::function<void(uint32_t)> task;
+        uint32_t count;
+        std::atomic<uint32_t> next = 0;
+        std::atomic<uint32_t> done = 0;
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+        std::exception_ptr exception;
+    };
+
+    auto pState = std::make_shared<ParallelForState>();
+    pState->task = task;
+    pState->count = count;
+
+    auto run = [pState]() {
+        uint32_t i;
+        while ((i = pState->next++) < pState->count) {
+            try {
+                pState->task(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(pState->doneMutex);
+                if (!pState->exception) pState->exception = std::current_exception();
+            }
+
+            if (++pState->done == pState->count) {
+                std::lock_guard<std::mutex> lock(pState->doneMutex);
+                pState->doneCondition.notify_all();
+            }
+        }
+    };
+
+    uint32_t helpersCount = std::min(count - 1, getThreadCount());
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        for (uint32_t i = 0; i < helpersCount; i++) {
+            tasks.push(run);
+        }
+    }
+    tasksCondition.notify_all();
+
+    run();
+
+    // wait for the items taken by helpers
+    std::unique_lock<std::mutex> lock(pState->doneMutex);
+    pState->doneCondition.wait(lock, [&]() { return pState->done == pState->count; });
+
+    if (pState->exception) std::rethrow_exception(pState->exception);
+}
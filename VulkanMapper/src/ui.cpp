@@ -3,6 +3,7 @@
 #include <imgui.h>
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include <nfd.h>
 #include "../include/image.h"
 
@@ -56,6 +57,10 @@ void UI::drawMediaManager() {
             pMediaManager->loadFile(filePath);
         }
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Play all", ImVec2{ 100, 100 })) {
+        pMediaManager->playAll();
+    }
 
     for (auto mediaId : mediasIds) {
         bool selected = false;
@@ -110,6 +115,26 @@ void UI::drawMediaManager() {
         ImGui::EndChild();
         ImGui::PopStyleVar();
     }
+
+    // media still loading
+    for (auto pPending : pMediaManager->getPendingMedias()) {
+        ImGui::SameLine();
+        ImGui::BeginChild((std::string("pending_media_") + std::to_string(pPending->id)).c_str(), ImVec2(100, 100), true);
+
+        ImGui::TextWrapped("%s", pPending->filePath.substr(pPending->filePath.find_last_of("\\") + 1).c_str());
+
+        uint64_t bytesTotal = pPending->progress.bytesTotal;
+        uint32_t framesCount = pPending->progress.framesCount;
+        uint64_t bytesToUpload = pPending->progress.bytesToUpload;
+
+        ImGui::ProgressBar(bytesTotal > 0 ? float(pPending->progress.bytesParsed) / float(bytesTotal) : 0.0f, ImVec2(-1.0f, 0.0f), "parse");
+        if (framesCount > 0) {
+            ImGui::Text("%u/%u frames", (uint32_t)pPending->progress.framesIndexed, framesCount);
+        }
+        ImGui::ProgressBar(bytesToUpload > 0 ? float(pPending->progress.bytesUploaded) / float(bytesToUpload) : 0.0f, ImVec2(-1.0f, 0.0f), "upload");
+
+        ImGui::EndChild();
+    }
     ImGui::EndChild();
 }
 
@@ -126,6 +151,9 @@ void UI::drawPropertiesManager() {
             ImGui::Text("File name: %s", pMedia->getFilePath().c_str());
             if (auto pVideo = dynamic_cast<Video*>(pMedia)) {
                 ImGui::Text("Type: Video");
+
+                // the decode thread plays the video meanwhile
+                std::lock_guard<std::mutex> lock(pApp->getMediaManager()->getMediaMutex());
                 drawVideoProperties(pVideo);
             }
             else if (auto pImage = dynamic_cast<Image*>(pMedia)) {
@@ -179,15 +207,94 @@ std::string UI::openFileDialog() {
 void UI::drawVideoProperties(Video* pVideo) {
     if (pVideo == nullptr) return;
 
+    ImGui::Text("Ingest: %.1f MB copied, peak RSS +%.1f MB",
+        pVideo->ingestStats.bytesCopied / (1024.0 * 1024.0),
+        (pVideo->ingestStats.peakResidentAfter - pVideo->ingestStats.peakResidentBefore) / (1024.0 * 1024.0)
+    );
+
+    ImGui::Text("Frame table: %.1f KB (%u bytes/frame)",
+        (double)pVideo->frames.count * pVideo->frames.getRowSize() / 1024.0,
+        pVideo->frames.getRowSize()
+    );
+
+    ImGui::Text("Bitstream buffer: %.1f MB%s",
+        pVideo->streamBufferSize / (1024.0 * 1024.0),
+        pVideo->streaming ? " (streaming)" : ""
+    );
+
+    int decodeAheadDepth = (int)pVideo->decodeAheadDepth;
+    if (ImGui::SliderInt("decode ahead", &decodeAheadDepth, 1, MAX_DECODE_AHEAD_DEPTH)) {
+        pVideo->decodeAheadDepth = (uint32_t)decodeAheadDepth;
+    }
+    ImGui::Text("Decoder: %s", pVideo->pDecoder->getName());
+    VideoSessionPool* pVideoSessionPool = pApp->getVulkanState()->getVideoSessionPool();
+    if (pVideoSessionPool != nullptr) {
+        VideoSessionPoolStats poolStats = pVideoSessionPool->getStats();
+        ImGui::Text("Video sessions: %llu created, %llu reused, %u pooled",
+            (unsigned long long)poolStats.created,
+            (unsigned long long)poolStats.reused,
+            poolStats.free
+        );
+    }
+    ImGui::Text("Decode: %s", pVideo->isIdle() ? (pVideo->visible ? "idle (paused)" : "idle (not shown)") : "active");
+    DecodeScheduler* pDecodeScheduler = pApp->getVulkanState()->getDecodeScheduler();
+    if (pDecodeScheduler != nullptr) {
+        ImGui::Text("Decode queue depth: %u (last batch: %u decodes)", pVideo->getDecodesInFlight(), pDecodeScheduler->getStats().lastBatchSize);
+    }
+    else {
+        ImGui::Text("Decode queue depth: %u", pVideo->getDecodesInFlight());
+    }
+    ImGui::Text("Loop pre-roll: %u frames", pVideo->getPrerolledFrames());
+
+    int frameCacheBudget = (int)(pVideo->getFrameCacheBudget() / (1024 * 1024));
+    if (ImGui::SliderInt("frame cache MB", &frameCacheBudget, 0, 4096)) {
+        pVideo->setFrameCacheBudget((uint64_t)frameCacheBudget * 1024 * 1024);
+    }
+
+    FrameCache* pFrameCache = pVideo->getFrameCache();
+    if (pFrameCache != nullptr) {
+        ImGui::Text("Frame cache: %.1f / %.1f MB%s",
+            pFrameCache->getUsedBytes() / (1024.0 * 1024.0),
+            pFrameCache->getRequiredBytes() / (1024.0 * 1024.0),
+            pVideo->isPlayingFromCache() ? " (playing from cache)" : ""
+        );
+    }
+
+    // scrubbing seeks to the frame shown at the slider time
+    float currentTime = (float)((double)pVideo->frames.timestamp[pVideo->currentFrame] / pVideo->timescale);
+    if (ImGui::SliderFloat("time", &currentTime, 0.0f, pVideo->durationSeconds, "%.2f s")) {
+        pVideo->seek(currentTime);
+    }
+
     int currentFrame = (int)pVideo->currentFrame;
 
     if (pVideo != nullptr) {
-        ImGui::SliderInt("frame",
+        if (ImGui::SliderInt("frame",
             &currentFrame,
             0,
-            (int)pVideo->framesCount
-        );
+            (int)pVideo->framesCount - 1
+        )) {
+            pVideo->seekFrame((uint32_t)currentFrame);
+        }
+    }
+    ImGui::Text("Last seek: %.1f ms", pVideo->lastSeekLatencySeconds * 1000.0f);
+
+    // negative rates play backwards
+    float playbackRate = pVideo->playbackRate;
+    if (ImGui::SliderFloat("rate", &playbackRate, -MAX_PLAYBACK_RATE, MAX_PLAYBACK_RATE, "%.2fx")) {
+        pVideo->setPlaybackRate(playbackRate);
     }
+    ImGui::Checkbox("limit rate to decoder", &pVideo->limitRateToDecoder);
+    ImGui::Text("Clock drift: %.2f ms (max %.2f ms), dropped frames: %llu",
+        pVideo->clockStats.driftNs / 1000000.0,
+        pVideo->clockStats.maxDriftNs / 1000000.0,
+        (unsigned long long)pVideo->clockStats.droppedFrames
+    );
+    ImGui::Text("Decode throughput: %.0f frames/s, sustains %.2fx%s",
+        pVideo->throughput.decodesPerSecond,
+        pVideo->throughput.sustainableRate,
+        pVideo->throughput.saturated ? " (saturated)" : ""
+    );
 
     if (ImGui::Button("first frame")) {
         pVideo->firstFrame();
@@ -264,6 +371,63 @@ void UI::deselectMedia() {
     selectedMedia = false;
 }
 
+// fills the view with a grid of small planes, the geometry arena grows to hold them
+ObjectId_t UI::addStressPlane() {
+    const uint32_t columns = 100;
+    const float size = 1.0f / columns;
+
+    // cells are reused as planes come and go
+    uint32_t cell = stressNextPlane++ % STRESS_PLANES_COUNT;
+    float posX = -0.5f + size * (cell % columns + 0.5f);
+    float posY = -0.5f + size * (cell / columns % columns + 0.5f);
+
+    Scene* pScene = pApp->getScene();
+    return pScene->addObject(new Plane(pApp, pScene, size * 0.8f, size * 0.8f, posX, posY));
+}
+
+void UI::stressStep() {
+    Scene* pScene = pApp->getScene();
+
+    // draw list build, geometry upload and indirect draws of the frame after the previous step
+    float frameMs = pApp->getVulkanState()->getSceneUpdateSeconds() * 1000.0f;
+    if (stressFrame == 1) {
+        stressStats.addFrameMs = frameMs;
+    }
+    else if (stressFrame > 1) {
+        stressTotalMs += frameMs;
+        stressStats.frames++;
+        stressStats.averageFrameMs = stressTotalMs / stressStats.frames;
+        stressStats.maxFrameMs = std::max(stressStats.maxFrameMs, frameMs);
+    }
+
+    if (stressFrame == 0) {
+        for (uint32_t i = 0; i < STRESS_PLANES_COUNT; i++) {
+            stressPlanes.push_back(addStressPlane());
+        }
+    }
+    else if (stressFrame <= STRESS_FRAMES) {
+        // the oldest planes go, new ones take their place at the end of the scene
+        for (uint32_t i = 0; i < STRESS_CHURN_PLANES; i++) {
+            pScene->removeObject(stressPlanes[i]);
+        }
+        stressPlanes.erase(stressPlanes.begin(), stressPlanes.begin() + STRESS_CHURN_PLANES);
+        for (uint32_t i = 0; i < STRESS_CHURN_PLANES; i++) {
+            stressPlanes.push_back(addStressPlane());
+        }
+    }
+    else {
+        // done, the scene is left as it was
+        for (ObjectId_t planeId : stressPlanes) {
+            pScene->removeObject(planeId);
+        }
+        stressPlanes.clear();
+        stressRunning = false;
+        return;
+    }
+
+    stressFrame++;
+}
+
 void UI::planesMenu() {
     Scene* pScene = pApp->getScene();
 
@@ -277,6 +441,43 @@ void UI::planesMenu() {
     ImGui::Text("Hovering: %i", pScene->getHoveringObjectId());
     ImGui::Text("Dragging: %i", pScene->getDragginObjectId());
 
+    GeometryBuffer* pGeometry = pApp->getVulkanState()->getGeometry();
+    ImGui::Text("Geometry upload: %llu bytes/frame (%u objects, %.2f ms)", (unsigned long long)pGeometry->getUploadedBytes(), pGeometry->getRewrittenObjects(), pGeometry->getUpdateSeconds() * 1000.0f);
+    ImGui::Text("Geometry arena: %.1f / %.1f KB, %u objects",
+        pGeometry->getUsedBytes() / 1024.0,
+        pGeometry->getCapacityBytes() / 1024.0,
+        (uint32_t)pScene->getObjects().size()
+    );
+
+    DrawList* pDrawList = pApp->getVulkanState()->getDrawList();
+    ImGui::Text("Draw list: %u packets, %u pipeline / %u material binds",
+        (uint32_t)pDrawList->getPackets().size(),
+        pDrawList->getPipelineChanges(),
+        pDrawList->getMaterialChanges()
+    );
+    ImGui::Text("Indirect draws: %u", (uint32_t)pApp->getVulkanState()->getIndirectDraws()->getBatches().size());
+
+    if (stressRunning) {
+        stressStep();
+        ImGui::Text("Stress test: frame %u / %u", stressFrame, STRESS_FRAMES);
+    }
+    else if (ImGui::Button("Stress test")) {
+        stressRunning = true;
+        stressFrame = 0;
+        stressTotalMs = 0.0f;
+        stressStats = {};
+    }
+    if (stressStats.frames > 0) {
+        ImGui::Text("%u planes: %.2f ms added, %.2f ms avg / %.2f ms max over %u frames churning %u",
+            STRESS_PLANES_COUNT,
+            stressStats.addFrameMs,
+            stressStats.averageFrameMs,
+            stressStats.maxFrameMs,
+            stressStats.frames,
+            STRESS_CHURN_PLANES
+        );
+    }
+
     
     ImGuiIO& io = ImGui::GetIO();
     ImGui::Text("Mouse pos: (%g, %g)", io.MousePos.x, io.MousePos.y);
@@ -285,8 +486,9 @@ void UI::planesMenu() {
 
     bool closable_group = true;
 
-    for (uint8_t object_id : pScene->getIds()) {
-        Object* object_ptr = pScene->getObjectPointer(object_id);
+    auto& objects = pScene->getObjects();
+    for (size_t i = 0; i < objects.size(); i++) {
+        Object* object_ptr = objects[i];
 
         if (object_ptr == nullptr) {
             continue;
@@ -310,6 +512,7 @@ void UI::planesMenu() {
                 ImGui::SeparatorText("Functions");
                 if (ImGui::Button("Remove")) {
                     pScene->removeObject(plane_ptr->getId());
+                    break;  // objects changed
                 }
 
                 ImGui::Separator();
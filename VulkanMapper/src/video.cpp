@@ -1,36 +1,111 @@
 #include "../include/video.h"
-#include "../include/read_file.h"
+#include "../include/mapped_file.h"
+#include "../include/video_index.h"
+#include "../include/slice_parser.h"
+#ifdef VM_CPU_DECODE
+#include "../include/cpu_video.h"
+#endif
 
 #include <h264.h>
 #include <minimp4.h>
 
 #include <iostream>
 #include <algorithm>
+#include <stdexcept>
+#include <cmath>
 
-static int read_callback(int64_t offset, void* buffer, size_t size, void* token) {
-    INPUT_BUFFER* buf = (INPUT_BUFFER*)token;
-    size_t to_copy = MINIMP4_MIN(size, buf->size - offset - size);
-    memcpy(buffer, buf->buffer + offset, to_copy);
-    return to_copy != size;
-}
-
-Video::Video(MediaId_t id, VulkanState* pDevice, std::string filePath) : Media(id, filePath) {
+Video::Video(MediaId_t id, VulkanState* pDevice, MasterClock* pMasterClock, ReadyFrameQueue* pReadyFrames, std::string filePath, MediaLoadProgress* pProgress, ThreadPool* pParsePool) : Media(id, filePath) {
     Video::pDevice = pDevice;
-    pVkDecoder = new VulkanVideo(pDevice);
+    Video::pMasterClock = pMasterClock;
+    Video::pReadyFrames = pReadyFrames;
 
-    vmVideoFrameStreamId = pDevice->createVideoFrameStream();
+    // decode backend
+    if (pDevice->hasVideoDecode()) {
+        pDecoder = new VulkanVideo(pDevice);
+    }
+    else {
+#ifdef VM_CPU_DECODE
+        pDecoder = new CpuVideo(pDevice);
+#else
+        throw std::runtime_error("no h264 decoder available, the device has no video decode queue!");
+#endif
+    }
+
+    MediaLoadProgress localProgress;
+    if (pProgress == nullptr) pProgress = &localProgress;
 
     // query video capabilities
-    uint64_t bitStreamAlignment = pVkDecoder->queryDecodeVideoCapabilities();
+    bitStreamAlignment = pDecoder->queryDecodeVideoCapabilities();
+
+    ingestStats.peakResidentBefore = queryPeakResidentBytes();
+
+    // map file, samples are read in place
+    pFile = new MappedFile(filePath);
+    pProgress->bytesTotal = pFile->getSize();
 
-    // load data
-    auto data = readFile(filePath);
-    uint8_t* inputBuf = (uint8_t*)data.data();
-    size_t inputSize = data.size();
+    // frame index, from the sidecar cache when it is still valid
+    if (loadVideoIndex(this, bitStreamAlignment)) {
+        pProgress->bytesParsed = pProgress->bytesTotal.load();
+        pProgress->framesCount = framesCount;
+        pProgress->framesIndexed = framesCount;
+    }
+    else {
+        parseTrack(pProgress, pParsePool);
+        if (framesCount > 0) saveVideoIndex(this, bitStreamAlignment);
+    }
+
+    if (framesCount == 0) {
+        delete pFile;
+        delete pDecoder;
+        throw std::runtime_error("no h264 video track found!");
+    }
+
+    buildKeyFrameIndex();
+
+    // whole track in the bitstream buffer when it fits,
+    // otherwise a ring covering the gops around the current frame
+    streaming = bitStreamSize > STREAM_RING_SIZE;
+    if (streaming) {
+        streamBufferSize = std::max(std::min(2 * maxGopSize, (uint64_t)STREAM_RING_SIZE), 2 * maxFrameSize);
+        pStreamRing = new BitstreamRing(streamBufferSize, bitStreamAlignment, framesCount);
+        pStreamData = pDecoder->mapVideoStream(streamBufferSize);   // stays mapped, refilled while playing
+
+        // fill the ring from the first frame
+        pProgress->bytesToUpload = streamBufferSize;
+        prepareStream();
+        pProgress->bytesUploaded = pStreamRing->getUsed();
+    }
+    else {
+        streamBufferSize = bitStreamSize;
+
+        // write stream data straight into the bitstream buffer
+        pProgress->bytesToUpload = streamBufferSize;
+        pStreamData = pDecoder->mapVideoStream(streamBufferSize);
+        for (uint32_t i = 0; i < framesCount; i++) {
+            uint64_t copied = writeFrame(i, pStreamData + frames.offset[i]);
+            ingestStats.bytesCopied += copied;
+            pProgress->bytesUploaded += copied;
+        }
+        pDecoder->unmapVideoStream();
+        pStreamData = nullptr;
+    }
+
+    // the file is only needed to refill the ring
+    if (!streaming) {
+        delete pFile;
+        pFile = nullptr;
+    }
+
+    ingestStats.peakResidentAfter = queryPeakResidentBytes();
+    std::cout << "ingest: " << ingestStats.bytesCopied << " bytes copied, peak rss +"
+        << (ingestStats.peakResidentAfter - ingestStats.peakResidentBefore) << " bytes" << std::endl;
+}
+
+void Video::parseTrack(MediaLoadProgress* pProgress, ThreadPool* pParsePool) {
+    const uint8_t* inputBuf = pFile->data();
 
-    INPUT_BUFFER buf = { inputBuf, inputSize };
     MP4D_demux_t mp4 = { 0, };
-    MP4D_open(&mp4, read_callback, &buf, inputSize);
+    MP4D_open(&mp4, mappedFileRead, pFile, pFile->getSize());
 
     for (uint32_t ntrack = 0; ntrack < mp4.track_count; ntrack++) {
         MP4D_track_t& track = mp4.track[ntrack];
@@ -107,31 +182,36 @@ Video::Video(MediaId_t id, VulkanState* pDevice, std::string filePath) : Media(i
 
         // get samples (frames)
         framesCount = track.sample_count;
-        frameInfos.resize(framesCount);
-        frameSliceHeaderData.reserve(framesCount * sizeof(h264::SliceHeader));
-
-        const h264::PPS* ppsArray = (const h264::PPS*)ppsData.data();
-        const h264::SPS* spsArray = (const h264::SPS*)spsData.data();
+        frames.resize(framesCount);
+        pProgress->framesCount = framesCount;
 
-        uint32_t trackDuration = 0;
+        // 64 bit track time, the 32 bit sample timestamps wrap in long files
+        uint64_t trackDuration = 0;
+        timescale = track.timescale;
 
         // aligned bitstream size
         bitStreamSize = 0;
-
-        int prevPicOrderCntLSB = 0;
-        int prevPicOrderCntMSB = 0;
-        int pocCycle = 0;
+        maxFrameSize = 0;
+        maxGopSize = 0;
+        uint64_t gopSize = 0;
 
         double timescaleRcp = 1.0 / double(track.timescale);
 
+        // locate the slices of every sample
         for (uint32_t i = 0; i < framesCount; i++) {
             unsigned frameBytes, timestamp, duration;
             MP4D_file_offset_t ofs = MP4D_frame_offset(&mp4, ntrack, i, &frameBytes, &timestamp, &duration);
+            frames.timestamp[i] = (int64_t)trackDuration;
+            frames.duration[i] = duration;
             trackDuration += duration;
+            pProgress->bytesParsed += frameBytes;
 
-            FrameInfo& info = frameInfos[i];
-            info.offset = bitStreamSize;
+            frames.offset[i] = bitStreamSize;
+            frames.firstSlice[i] = slices.count;
+            frames.type[i] = FrameType::PredictiveFrame;
 
+            // every slice nal of the access unit, sliced encodes have several,
+            // they are written back to back with start codes and decoded together
             const uint8_t* srcBuffer = inputBuf + ofs;
             while (frameBytes > 0) {
                 uint32_t size = ((uint32_t)srcBuffer[0] << 24) | ((uint32_t)srcBuffer[1] << 16) | ((uint32_t)srcBuffer[2] << 8) | srcBuffer[3];
@@ -139,190 +219,577 @@ Video::Video(MediaId_t id, VulkanState* pDevice, std::string filePath) : Media(i
                 assert(frameBytes >= size);
 
                 h264::Bitstream bs = {};
-                bs.init(&srcBuffer[4], frameBytes);
+                bs.init(&srcBuffer[4], sizeof(uint8_t));
                 h264::NALHeader nal = {};
                 h264::read_nal_header(&nal, &bs);
 
-                if (nal.type == h264::NAL_UNIT_TYPE_CODED_SLICE_IDR) {
-                    info.type = FrameType::IntraFrame;
-                }
-                else if (nal.type == h264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR) {
-                    info.type = FrameType::PredictiveFrame;
-                }
-                else {
-                    // Continue search for frame beginning NAL unit:
-                    frameBytes -= size;
-                    srcBuffer += size;
-                    continue;
-                }
-
-                h264::SliceHeader* sliceHeader = (h264::SliceHeader*)frameSliceHeaderData.data() + i;
-                *sliceHeader = {};
-                h264::read_slice_header(sliceHeader, &nal, ppsArray, spsArray, &bs);
-
-                const h264::PPS& pps = ppsArray[sliceHeader->pic_parameter_set_id];
-                const h264::SPS& sps = spsArray[pps.seq_parameter_set_id];
+                if (nal.type == h264::NAL_UNIT_TYPE_CODED_SLICE_IDR || nal.type == h264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR) {
+                    if (nal.type == h264::NAL_UNIT_TYPE_CODED_SLICE_IDR) frames.type[i] = FrameType::IntraFrame;
+                    frames.referencePriority[i] = std::max(frames.referencePriority[i], (uint8_t)nal.idc);
 
-                // Rec. ITU-T H.264 (08/2021) page 77
-                int maxPicOrderCntLSB = 1 << (sps.log2_max_pic_order_cnt_lsb_minus4 + 4);
-                int picOrderCntLSB = sliceHeader->pic_order_cnt_lsb;
-
-                if (picOrderCntLSB == 0) {
-                    pocCycle++;
+                    uint32_t sliceSize = sizeof(h264::nal_start_code) + size - 4;
+                    slices.push((uint64_t)(srcBuffer - inputBuf) + 4, sliceSize, frames.size[i]);
+                    frames.size[i] += sliceSize;
+                    frames.sliceCount[i]++;
                 }
 
-                // Rec. ITU-T H.264 (08/2021) page 115
-                // Also: https://www.ramugedia.com/negative-pocs
-                int picOrderCntMSB = 0;
-                if (picOrderCntLSB < prevPicOrderCntLSB && (prevPicOrderCntLSB - picOrderCntLSB) >= maxPicOrderCntLSB / 2) {
-                    picOrderCntMSB = prevPicOrderCntMSB + maxPicOrderCntLSB; // pic_order_cnt_lsb wrapped around
-                }
-                else if (picOrderCntLSB > prevPicOrderCntLSB && (picOrderCntLSB - prevPicOrderCntLSB) > maxPicOrderCntLSB / 2) {
-                    picOrderCntMSB = prevPicOrderCntMSB - maxPicOrderCntLSB; // here negative POC might occur
-                }
-                else {
-                    picOrderCntMSB = prevPicOrderCntMSB;
-                }
-                //pic_order_cnt_msb = pic_order_cnt_msb % 256;
-                prevPicOrderCntLSB = picOrderCntLSB;
-                prevPicOrderCntMSB = picOrderCntMSB;
-
-                // https://www.vcodex.com/h264avc-picture-management/
-                info.poc = picOrderCntMSB + picOrderCntLSB; // poc = TopFieldOrderCount
-                info.gop = pocCycle - 1;
-
-                // Accept frame beginning NAL unit:
-                info.referencePriority = nal.idc;
-                info.size = sizeof(h264::nal_start_code) + size - 4;
-                break;
+                frameBytes -= size;
+                srcBuffer += size;
             }
 
-            bitStreamSize += ((info.size + bitStreamAlignment - 1) / bitStreamAlignment) * bitStreamAlignment;
-            info.timestampSeconds = float(double(timestamp) * timescaleRcp);
-            info.durationSeconds = float(double(duration) * timescaleRcp);
+            uint64_t alignedSize = ((frames.size[i] + bitStreamAlignment - 1) / bitStreamAlignment) * bitStreamAlignment;
+            bitStreamSize += alignedSize;
 
-            std::cout << info.timestampSeconds << "\t" << info.type << "\t" << info.size << std::endl;
+            // track the largest frame and gop to size the streaming ring
+            if (frames.type[i] == FrameType::IntraFrame) gopSize = 0;
+            gopSize += alignedSize;
+            maxGopSize = std::max(maxGopSize, gopSize);
+            maxFrameSize = std::max(maxFrameSize, alignedSize);
         }
 
+        // parse slice headers, gops are independent
+        parseSliceHeaders(frames, slices, inputBuf, spsData, ppsData, pParsePool, &pProgress->framesIndexed);
+
         // display order
         std::vector<size_t> frameDisplayOrder;
-        frameDisplayOrder.resize(frameInfos.size());
-        for (size_t i = 0; i < frameInfos.size(); i++) {
+        frameDisplayOrder.resize(framesCount);
+        for (size_t i = 0; i < framesCount; i++) {
             frameDisplayOrder[i] = i;
         }
         std::sort(frameDisplayOrder.begin(), frameDisplayOrder.end(), [&](size_t a, size_t b) {
-            const FrameInfo& frameA = frameInfos[a];
-            const FrameInfo& frameB = frameInfos[b];
-            int64_t prioA = (int64_t(frameA.gop) << 32ll) | int64_t(frameA.poc);
-            int64_t prioB = (int64_t(frameB.gop) << 32ll) | int64_t(frameB.poc);
+            int64_t prioA = (int64_t(frames.gop[a]) << 32ll) | int64_t(frames.poc[a]);
+            int64_t prioB = (int64_t(frames.gop[b]) << 32ll) | int64_t(frames.poc[b]);
             return prioA < prioB;
             });
         for (size_t i = 0; i < frameDisplayOrder.size(); ++i) {
-            frameInfos[frameDisplayOrder[i]].displayOrder = (int)i;
+            frames.displayOrder[frameDisplayOrder[i]] = (int32_t)i;
         }
 
         averageFrameRate = float(double(track.timescale) / double(trackDuration) * track.sample_count);
         durationSeconds = float(double(trackDuration) * timescaleRcp);
+        durationTicks = (int64_t)trackDuration;
+    }
 
-        // assemble stream data
-        std::vector<uint8_t> streamData;
-        streamData.resize(bitStreamSize);
-        for (uint32_t i = 0; i < framesCount; i++) {
-            unsigned frameBytes, timestamp, duration;
-            MP4D_file_offset_t ofs = MP4D_frame_offset(&mp4, ntrack, i, &frameBytes, &timestamp, &duration);
-            uint8_t* dstBuffer = (uint8_t*)streamData.data() + frameInfos[i].offset;
-            const uint8_t* srcBuffer = inputBuf + ofs;
-            while (frameBytes > 0) {
-                uint32_t size = ((uint32_t)srcBuffer[0] << 24) | ((uint32_t)srcBuffer[1] << 16) | ((uint32_t)srcBuffer[2] << 8) | srcBuffer[3];
-                size += 4;
-                assert(frameBytes >= size);
+    MP4D_close(&mp4);
+}
 
-                h264::Bitstream bs = {};
-                bs.init(&srcBuffer[4], sizeof(uint8_t));
-                h264::NALHeader nal = {};
-                h264::read_nal_header(&nal, &bs);
+void Video::buildKeyFrameIndex() {
+    keyFrames.clear();
+    displayToDecodeOrder.resize(framesCount);
 
-                if (
-                    nal.type != h264::NAL_UNIT_TYPE_CODED_SLICE_IDR &&
-                    nal.type != h264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR
-                    ) {
-                    frameBytes -= size;
-                    srcBuffer += size;
-                    continue;
-                }
+    for (uint32_t i = 0; i < framesCount; i++) {
+        // the first frame starts decoding even when it's not an idr
+        if (i == 0 || frames.type[i] == FrameType::IntraFrame) keyFrames.push_back(i);
+        displayToDecodeOrder[frames.displayOrder[i]] = i;
+    }
+}
+
+void Video::upload() {
+    vmVideoFrameStreamId = pDevice->createVideoFrameStream();
+
+    // room for the decodes ahead, the loop pre-roll, the shown frame and the one handed to the renderer next to the references
+    numReferenceFrames = std::max(1u, numDpbSlots - 1);
+    decodeLatency = pDecoder->getDecodeLatency(this);
+    numDpbSlots = pDecoder->clampDpbSlots(numDpbSlots + MAX_DECODE_AHEAD_DEPTH + LOOP_PREROLL_DEPTH + decodeLatency + 2);
+    // per frame state is sized once, decoding allocates nothing
+    dpbSlots.resize(numDpbSlots, numReferenceFrames);
+    pDecodeQueue = new DecodeQueue(&dpbSlots, pDecoder);
+    publishedFrames.reserve(READY_FRAME_QUEUE_SIZE);
+
+    pDecoder->setupDecoder(this);
+
+    setFrameCacheBudget(frameCacheBudget);
+
+    // reverse pool, bounded by two windows and a block of slack for the frames handed to the renderer
+    pReverseWindow = new FrameCache(pDevice, width, height, framesCount);
+    pReverseWindow->setBudget(pReverseWindow->getBytesFor(2 * REVERSE_WINDOW_FRAMES + FRAME_CACHE_BLOCK_FRAMES), [](uint32_t) { return false; });
+    slotCaptures.reserve(numDpbSlots);
 
-                std::memcpy(dstBuffer, h264::nal_start_code, sizeof(h264::nal_start_code));
-                std::memcpy(dstBuffer + sizeof(h264::nal_start_code), srcBuffer + 4, size - 4);
-                break;
+    skippedFrames.assign(framesCount, 0);
+
+    // the first frame is shown by the decode thread (presentAFrame)
+}
+
+uint64_t Video::writeFrame(uint32_t frame, uint8_t* dstBuffer) {
+    uint64_t size = frames.size[frame];
+    uint64_t alignedSize = ((size + bitStreamAlignment - 1) / bitStreamAlignment) * bitStreamAlignment;
+
+    // each slice nal behind its start code
+    uint64_t copied = 0;
+    uint32_t lastSlice = frames.firstSlice[frame] + frames.sliceCount[frame];
+    for (uint32_t slice = frames.firstSlice[frame]; slice < lastSlice; slice++) {
+        uint8_t* pSliceBuffer = dstBuffer + slices.offset[slice];
+        std::memcpy(pSliceBuffer, h264::nal_start_code, sizeof(h264::nal_start_code));
+        std::memcpy(pSliceBuffer + sizeof(h264::nal_start_code), pFile->data() + slices.fileOffset[slice], slices.size[slice] - sizeof(h264::nal_start_code));
+        copied += slices.size[slice];
+    }
+
+    // clear alignment padding, the buffer memory is not zeroed
+    std::memset(dstBuffer + size, 0, alignedSize - size);
+
+    return copied;
+}
+
+bool Video::prepareStream() {
+    // release frames already decoded, in flight decodes still read their bitstream,
+    // reference only decodes included (seek and reverse window lead-ins)
+    pDecodeQueue->retire();
+    uint32_t keepFrame = pDecodeQueue->getKeepFrame(nextDecodeFrame);
+    while (!pStreamRing->empty() && pStreamRing->frontFrame() != keepFrame) {
+        pStreamRing->pop();
+    }
+
+    // kept frame is not in the ring (jump), restart from it
+    if (pStreamRing->empty()) {
+        pStreamRing->clear();
+        nextStreamFrame = keepFrame;
+    }
+
+    // refill ahead of playback, looping to the start of the track
+    uint64_t offset = 0;
+    while (pStreamRing->push(nextStreamFrame, frames.size[nextStreamFrame], offset)) {
+        frames.offset[nextStreamFrame] = offset;
+        writeFrame(nextStreamFrame, pStreamData + offset);
+
+        nextStreamFrame = (nextStreamFrame + 1) % framesCount;
+        if (nextStreamFrame == keepFrame) break;     // whole track resident
+    }
+
+    return pStreamRing->contains(nextDecodeFrame);
+}
+
+uint32_t Video::getDecodeQueueTarget() {
+    uint32_t target = decodeAheadDepth + decodeLatency;
+
+    // near the loop point the first frames of the next iteration are decoded early,
+    // the wrap to frame 0 then presents from frames already in the dpb
+    uint32_t framesToLoop = framesCount - nextPresentOrder;
+    if (framesToLoop <= target + LOOP_PREROLL_DEPTH) {
+        target += LOOP_PREROLL_DEPTH;
+    }
+
+    return target;
+}
+
+uint32_t Video::getPrerolledFrames() {
+    // frames shown before the next one belong to the next iteration
+    uint32_t prerolledFrames = 0;
+    for (DecodeFrameResult* pResult : pDecodeQueue->getQueued()) {
+        if ((uint32_t)frames.displayOrder[pResult->frame] < nextPresentOrder) prerolledFrames++;
+    }
+    return prerolledFrames;
+}
+
+void Video::flushDecodeQueue() {
+    // nothing waits, decodes already running complete and keep their slot and bitstream until retired
+    pDecodeQueue->flush();
+
+    // slots still copied stay in use until their batch ran (slotCaptures)
+
+    // skips belong to the flushed decodes
+    std::fill(skippedFrames.begin(), skippedFrames.end(), 0);
+}
+
+bool Video::queueDecode(std::chrono::steady_clock::time_point deadline, bool present) {
+    if (streaming && !prepareStream()) return false;    // bitstream ring full of in flight frames
+
+    // the result is kept with the slot, a frame not presented is only a reference of later frames, never shown
+    if (!pDecodeQueue->queue(this, frames, nextDecodeFrame, present, deadline)) return false;
+    windowDecodes++;
+
+    return true;
+}
+
+void Video::decodeFrame() {
+    retirePublishedFrames();
+    releaseCapturedSlots();
+    pDecodeQueue->retire();
+    updateThroughput();
+    releaseFrameCache();
+
+    // whole loop cached, the decoder stays idle
+    if (pFrameCache != nullptr && pFrameCache->isComplete()) {
+        if (!playingFromCache) {
+            flushDecodeQueue();
+            playingFromCache = true;
+        }
+
+        presentFromCache();
+        return;
+    }
+
+    // cache shrunk below the loop, decoding resumes from the keyframe before the next frame
+    if (playingFromCache) {
+        playingFromCache = false;
+        seekFrame(nextPresentOrder);
+    }
+
+    if (playbackRate < 0.0f && playing) {
+        decodeReverse();
+        return;
+    }
+
+    // present in display order, the next frame is shown once decoded and due
+    dropSkippedFrames();
+    DecodeFrameResult* pResult = pDecodeQueue->find(frames, nextPresentOrder);
+    if (pResult != nullptr) {
+        bool decoded = pDecoder->isDecoded(pResult);
+        bool due = isDue();
+        if (due && !decoded) windowSaturated = true;
+
+        if (decoded && due) {
+            // late, skip to the newest decoded frame that is due (not across the loop point)
+            while (playing && !presentAFrame && nextPresentOrder + 1 < framesCount) {
+                uint32_t laterOrder = nextPresentOrder + 1;
+                if (skippedFrames[laterOrder] || !isReached(laterOrder)) break;
+
+                DecodeFrameResult* pLater = pDecodeQueue->find(frames, laterOrder);
+                if (pLater == nullptr || !pDecoder->isDecoded(pLater)) break;
+
+                pDecodeQueue->remove(pResult);
+
+                stepPresentOrder();
+                windowFramesAdvanced++;
+                clockStats.droppedFrames++;
+
+                pResult = pLater;
             }
+
+            measureDrift();
+            int dpbSlot = (int)pResult->dpbSlot;
+            VmVideoFrame frame;
+            pDecoder->getFrame(dpbSlot, &frame);
+            pDecodeQueue->remove(pResult);
+            bool published = publishFrame(frame, dpbSlot);     // emit frame
+
+            // fill the cache while the loop plays once
+            if (published && pFrameCache != nullptr && pFrameCache->fits() && !pFrameCache->contains(nextPresentOrder)
+                && pFrameCache->capture(nextPresentOrder, frame.image, frame.layer, frame.layout)) {
+                slotCaptures.push_back({ pFrameCache, dpbSlot, pFrameCache->submitCaptures() });
+                dpbSlots[dpbSlot].capturing = true;
+            }
+
+            if (seekPending) finishSeek();
+            advancePresent();
+        }
+    }
+
+    // the scheduler serves the video with the closest presentation first
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    if (playing || presentAFrame) deadline = getDeadline();
+
+    // keep the decoder busy up to the decode ahead depth (plus what the backend holds back and the loop pre-roll),
+    // and past it until the next frame in display order is submitted
+    bool skipNonReference = playing && playbackRate > SKIP_NON_REFERENCE_RATE;
+    while (true) {
+        dropSkippedFrames();
+        if (pDecodeQueue->size() >= getDecodeQueueTarget() && pDecodeQueue->find(frames, nextPresentOrder) != nullptr) break;
+
+        // frames nothing references are not decoded when seeking past them or at high rates
+        bool seekSkip = seekTargetOrder >= 0 && frames.displayOrder[nextDecodeFrame] < seekTargetOrder;
+        if (frames.referencePriority[nextDecodeFrame] == 0 && (seekSkip || skipNonReference)) {
+            if (!seekSkip) skippedFrames[frames.displayOrder[nextDecodeFrame]] = 1;
+        }
+        else if (!queueDecode(deadline, !seekSkip)) {
+            break;
         }
 
-        pVkDecoder->loadVideoStream(streamData.data(), streamData.size());
-        pVkDecoder->setupDecoder(this);
+        // advance frame, the seek ends with the iteration
+        nextDecodeFrame = (nextDecodeFrame + 1) % framesCount;
+        if (nextDecodeFrame == 0) seekTargetOrder = -1;
     }
+}
 
-    MP4D_close(&mp4);
+void Video::dropSkippedFrames() {
+    while (skippedFrames[nextPresentOrder]) {
+        skippedFrames[nextPresentOrder] = 0;
+        stepPresentOrder();
+        windowFramesAdvanced++;
+    }
+}
 
-    // decode first frame
-    decodeFrame();
+void Video::startReverseWindow(uint32_t high) {
+    reverseWindowHigh = high;
+    reverseWindowLow = high >= REVERSE_WINDOW_FRAMES - 1 ? high - (REVERSE_WINDOW_FRAMES - 1) : 0;
+
+    // decode range covering the window, from the keyframe before its first frame in decode order
+    uint32_t firstDecodeFrame = framesCount;
+    uint32_t lastDecodeFrame = 0;
+    for (uint32_t i = (uint32_t)reverseWindowLow; i <= reverseWindowHigh; i++) {
+        firstDecodeFrame = std::min(firstDecodeFrame, displayToDecodeOrder[i]);
+        lastDecodeFrame = std::max(lastDecodeFrame, displayToDecodeOrder[i]);
+    }
+    auto keyFrameIt = std::upper_bound(keyFrames.begin(), keyFrames.end(), firstDecodeFrame);
+    nextDecodeFrame = *(keyFrameIt - 1);
+    reverseWindowEnd = lastDecodeFrame + 1;
 }
 
-void Video::decodeFrame() {
-    if (decodingResult != nullptr) {     // if waiting for a frame to be decoded
-        std::chrono::steady_clock::time_point currentTime = std::chrono::high_resolution_clock::now();
-        float timePassed = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
-        if (
-            vkGetFenceStatus(pDevice->getDevice(), decodingResult->decodeFence) == VK_SUCCESS &&    // finished decoding
-            (
-                (timePassed >= frameInfos[currentFrame].timestampSeconds && playing)                // time to emit (or)
-                || presentAFrame                                                                    // present a frame anyway
-                )
-            ) {
-            vkResetFences(pDevice->getDevice(), 1, &(decodingResult->decodeFence));
-            pDevice->loadVideoFrame(vmVideoFrameStreamId, decodingResult->frameImageView);  // emit frame
-
-            delete decodingResult;
-            decodingResult = nullptr;
-
-            if (presentAFrame) presentAFrame = false;
+void Video::decodeReverse() {
+    // jump, the next frame is neither pooled nor being decoded
+    bool inWindow = reverseWindowLow >= 0 && nextPresentOrder >= reverseWindowLow && nextPresentOrder <= reverseWindowHigh;
+    if (!inWindow && !pReverseWindow->contains(nextPresentOrder)) {
+        flushDecodeQueue();
+        seekTargetOrder = -1;
+
+        pReverseWindow->evictWhere([this](uint32_t displayOrder) { return !isPublished(displayOrder); });
+        startReverseWindow(nextPresentOrder);
+    }
+
+    // window decoded, start the one below while this one is shown
+    uint32_t nextHigh = reverseWindowLow == 0 ? framesCount - 1 : (uint32_t)reverseWindowLow - 1;
+    if (nextDecodeFrame >= reverseWindowEnd && pDecodeQueue->empty() && !pReverseWindow->contains(nextHigh)) {
+        // keep the frames still to show and the shown one
+        uint32_t showLow = (uint32_t)reverseWindowLow;
+        pReverseWindow->evictWhere([this, showLow](uint32_t displayOrder) {
+            bool toShow = nextPresentOrder >= showLow ? displayOrder >= showLow && displayOrder <= nextPresentOrder : displayOrder <= nextPresentOrder || displayOrder >= showLow;
+            return !toShow && !isPublished(displayOrder);
+            });
+        startReverseWindow(nextHigh);
+    }
+
+    // move decoded frames into the pool in one copy batch, a frame without room waits for shown frames to retire
+    const std::vector<DecodeFrameResult*>& queued = pDecodeQueue->getQueued();
+    uint32_t captured = 0;
+    while (captured < queued.size() && pDecoder->isDecoded(queued[captured])) {
+        DecodeFrameResult* pResult = queued[captured];
+        VmVideoFrame frame;
+        pDecoder->getFrame(pResult->dpbSlot, &frame);
+        if (!pReverseWindow->capture(frames.displayOrder[pResult->frame], frame.image, frame.layer, frame.layout)) break;
+        captured++;
+    }
+
+    // dpb slots are free for the rest of the window once their copy ran
+    if (captured > 0) {
+        uint64_t captureSequence = pReverseWindow->submitCaptures();
+        for (uint32_t i = 0; i < captured; i++) {
+            DecodeFrameResult* pResult = queued.front();
+            dpbSlots[pResult->dpbSlot].capturing = true;
+            slotCaptures.push_back({ pReverseWindow, (int)pResult->dpbSlot, captureSequence });
+            pDecodeQueue->remove(pResult);
         }
-        else {
-            //std::cout << "time remaining for frame " << currentFrame << ": " << frameInfos[currentFrame].timestampSeconds - timePassed << std::endl;
-            return;    // frame still decoding, skip
+    }
+
+    // present backwards from the pool
+    bool pooled = pReverseWindow->contains(nextPresentOrder);
+    bool due = isDue();
+    if (due && !pooled) windowSaturated = true;
+
+    if (pooled && due) {
+        skipLateFrames(pReverseWindow);
+        measureDrift();
+        publishFrame({ pReverseWindow->use(nextPresentOrder) }, -1);
+
+        if (seekPending) finishSeek();
+        advancePresent();
+    }
+
+    // decode the window forward, frames outside it are decoded only when referenced
+    std::chrono::steady_clock::time_point deadline = getDeadline();
+    while (nextDecodeFrame < reverseWindowEnd) {
+        uint32_t displayOrder = frames.displayOrder[nextDecodeFrame];
+        bool shown = displayOrder >= reverseWindowLow && displayOrder <= reverseWindowHigh;
+
+        if (shown || frames.referencePriority[nextDecodeFrame] > 0) {
+            if (!queueDecode(deadline, shown)) break;
         }
+
+        nextDecodeFrame++;
+    }
+}
+
+bool Video::publishFrame(const VmVideoFrame& frame, int dpbSlot) {
+    ReadyFrame readyFrame = { getId(), vmVideoFrameStreamId, frame, publishedSequence + 1 };
+    if (!pReadyFrames->push(readyFrame)) {
+        clockStats.droppedFrames++;     // the renderer is behind
+        return false;
     }
-    else {  // decode next frame
-        FrameInfo currentFrameInfo = frameInfos[currentFrame];
 
-        // reset dpb on intra frame
-        if (currentFrameInfo.type == FrameType::IntraFrame) {
-            //std::cout << "intra frame" << std::endl;
-            referencesPositions.clear();
-            currentDecodePosition = 0;
-            nextDecodePosition = 0;
+    publishedSequence++;
+    publishedFrames.push_back({ publishedSequence, dpbSlot, nextPresentOrder });
+    if (dpbSlot >= 0) dpbSlots[dpbSlot].presented = true;
+
+    return true;
+}
+
+void Video::retirePublishedFrames() {
+    // a frame is done once the renderer shows a newer one, older frames may have never been shown
+    uint64_t sequence = shownSequence.load(std::memory_order_acquire);
+    while (publishedFrames.size() > 1 && publishedFrames[1].sequence <= sequence) {
+        int dpbSlot = publishedFrames.front().dpbSlot;
+        if (dpbSlot >= 0) dpbSlots[dpbSlot].presented = false;     // a cache copy still reading it keeps it (capturing)
+        publishedFrames.erase(publishedFrames.begin());
+    }
+}
+
+void Video::releaseCapturedSlots() {
+    // nothing waits for the copies, their batches are polled
+    for (size_t i = 0; i < slotCaptures.size();) {
+        const SlotCapture& slotCapture = slotCaptures[i];
+        if (!slotCapture.pCache->isCaptured(slotCapture.captureSequence)) {
+            i++;
+            continue;
         }
 
-        // update dpb position
-        currentDecodePosition = nextDecodePosition;
+        dpbSlots[slotCapture.dpbSlot].capturing = false;
+        slotCaptures.erase(slotCaptures.begin() + i);
+    }
+}
 
-        // vk decode
-        decodingResult = pVkDecoder->decodeFrame(this);
+bool Video::isCapturing(FrameCache* pCache) {
+    return std::any_of(slotCaptures.begin(), slotCaptures.end(), [pCache](const SlotCapture& slotCapture) { return slotCapture.pCache == pCache; });
+}
 
-        // dpb management
-        if (currentFrameInfo.referencePriority > 0) {   // if frame is used as reference
-            if (referencesPositions.size() < 1) {
-                referencesPositions.resize(1);
-                //referenceSlotPositions.resize(referenceSlotPositions.size() + 1);
-            }
-            referencesPositions[0] = currentDecodePosition;
-            nextDecodePosition = ++(nextDecodePosition) % numDpbSlots;
-            // ignoring wickedengine's next_slot
+bool Video::isPublished(uint32_t displayOrder) {
+    for (const PublishedFrame& publishedFrame : publishedFrames) {
+        if (publishedFrame.displayOrder == displayOrder) return true;
+    }
+    return false;
+}
+
+std::chrono::steady_clock::time_point Video::getNextDeadline() {
+    if (!playing) return std::chrono::steady_clock::time_point::max();
+    return getDeadline();
+}
+
+bool Video::isReached(uint32_t displayOrder) {
+    // sample timestamps are in decode order, the n-th shown frame takes the n-th sample time
+    int64_t mediaTime = getMediaTime();
+    return rateNumerator > 0 ? mediaTime >= frames.timestamp[displayOrder] : mediaTime <= frames.timestamp[displayOrder];
+}
+
+bool Video::isDue() {
+    return (isReached(nextPresentOrder) && playing)     // time to emit (or)
+        || presentAFrame;                               // present a frame anyway
+}
+
+void Video::advancePresent() {
+    currentFrame = nextPresentOrder;
+    stepPresentOrder();
+    windowFramesAdvanced++;
+
+    if (presentAFrame) presentAFrame = false;
+}
+
+void Video::stepPresentOrder() {
+    // loop, next frame timestamps start over, exact in track ticks
+    if (rateNumerator > 0) {
+        nextPresentOrder = (nextPresentOrder + 1) % framesCount;
+        if (nextPresentOrder == 0) anchorMediaTime -= durationTicks;
+    }
+    else if (nextPresentOrder == 0) {
+        nextPresentOrder = framesCount - 1;
+        anchorMediaTime += durationTicks;
+    }
+    else {
+        nextPresentOrder--;
+    }
+}
+
+void Video::skipLateFrames(FrameCache* pPool) {
+    if (!playing || presentAFrame) return;
+
+    // late, step to the newest pooled frame that is due (not across the loop point)
+    while (true) {
+        uint32_t laterOrder;
+        if (rateNumerator > 0) {
+            if (nextPresentOrder + 1 >= framesCount) break;
+            laterOrder = nextPresentOrder + 1;
+        }
+        else {
+            if (nextPresentOrder == 0) break;
+            laterOrder = nextPresentOrder - 1;
+        }
+
+        if (!pPool->contains(laterOrder) || !isReached(laterOrder)) break;
+
+        stepPresentOrder();
+        windowFramesAdvanced++;
+        clockStats.droppedFrames++;
+    }
+}
+
+int64_t Video::getMediaTime() {
+    // elapsed master nanoseconds * rate, in track ticks
+    int64_t elapsed = pMasterClock->now() - anchorMasterTime;
+    return anchorMediaTime + rescaleTime(elapsed * rateNumerator, MASTER_CLOCK_TIMESCALE * PLAYBACK_RATE_DENOMINATOR, timescale);
+}
+
+int64_t Video::toMasterTime(int64_t mediaTime) {
+    int64_t mediaElapsed = (mediaTime - anchorMediaTime) * PLAYBACK_RATE_DENOMINATOR;
+    return anchorMasterTime + rescaleTime(mediaElapsed, (int64_t)timescale * rateNumerator, MASTER_CLOCK_TIMESCALE);
+}
+
+std::chrono::steady_clock::time_point Video::getDeadline() {
+    return pMasterClock->toTimePoint(toMasterTime(frames.timestamp[nextPresentOrder]));
+}
+
+void Video::measureDrift() {
+    // forced presents are not scheduled
+    if (!playing || presentAFrame) return;
+
+    clockStats.driftNs = pMasterClock->now() - toMasterTime(frames.timestamp[nextPresentOrder]);
+    clockStats.maxDriftNs = std::max(clockStats.maxDriftNs, clockStats.driftNs);
+}
+
+void Video::updateThroughput() {
+    std::chrono::steady_clock::time_point currentTime = std::chrono::high_resolution_clock::now();
+    float elapsed = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - throughputWindowStart).count();
+    if (elapsed < 1.0f) return;
+
+    throughput.decodesPerSecond = windowDecodes / elapsed;
+    throughput.saturated = windowSaturated;
+
+    // rate the playback actually advanced at, an upper bound of what the decoder sustains when it fell behind
+    float achievedRate = windowFramesAdvanced / elapsed / averageFrameRate;
+    if (windowSaturated && playing) {
+        throughput.sustainableRate = std::clamp(achievedRate, MIN_PLAYBACK_RATE, MAX_PLAYBACK_RATE);
+
+        if (limitRateToDecoder && std::abs(playbackRate) > throughput.sustainableRate) {
+            applyPlaybackRate(std::copysign(throughput.sustainableRate, playbackRate));
         }
+    }
+    else if (playing) {
+        throughput.sustainableRate = std::max(throughput.sustainableRate, std::min(achievedRate, MAX_PLAYBACK_RATE));
+    }
+
+    throughputWindowStart = currentTime;
+    windowDecodes = 0;
+    windowFramesAdvanced = 0;
+    windowSaturated = false;
+}
+
+void Video::presentFromCache() {
+    if (!isDue()) return;
+
+    skipLateFrames(pFrameCache);
+    measureDrift();
+    publishFrame({ pFrameCache->use(nextPresentOrder) }, -1);
+
+    if (seekPending) finishSeek();
+    advancePresent();
+}
+
+void Video::setFrameCacheBudget(uint64_t budget) {
+    frameCacheBudget = budget;
 
-        // advance frame
-        currentFrame = ++(currentFrame) % framesCount;
-        if (currentFrame == 0) startTime = std::chrono::high_resolution_clock::now();
+    // created with the first budget, released by the decode thread once disabled and empty
+    if (pFrameCache == nullptr) {
+        if (budget == 0) return;
+        pFrameCache = new FrameCache(pDevice, width, height, framesCount);
+    }
+
+    // frames the renderer may still show stay cached
+    pFrameCache->setBudget(budget, [this](uint32_t displayOrder) { return isPublished(displayOrder); });
+}
+
+void Video::releaseFrameCache() {
+    if (pFrameCache == nullptr || frameCacheBudget > 0) return;
+
+    // shown frames are evicted once the renderer moved past them
+    pFrameCache->setBudget(0, [this](uint32_t displayOrder) { return isPublished(displayOrder); });
+    if (pFrameCache->isReleased() && !isCapturing(pFrameCache)) {
+        delete pFrameCache;
+        pFrameCache = nullptr;
     }
 }
 
@@ -332,22 +799,152 @@ void Video::pause() {
 
 void Video::play() {    
     playing = true;
-    std::chrono::steady_clock::time_point currentTime = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration<float>(frameInfos[currentFrame].timestampSeconds);
-    auto castedDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
-    startTime = currentTime - castedDuration;
-    //float timePassed = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    resetClock();
+}
+
+void Video::playAt(int64_t masterTime) {
+    playing = true;
+    resetClock();
+    anchorMasterTime = masterTime;
+}
+
+void Video::setPlaybackRate(float rate) {
+    // a new rate is measured again
+    throughput.sustainableRate = MAX_PLAYBACK_RATE;
+    applyPlaybackRate(rate);
+}
+
+void Video::applyPlaybackRate(float rate) {
+    float magnitude = std::clamp(std::abs(rate), MIN_PLAYBACK_RATE, MAX_PLAYBACK_RATE);
+    rate = std::copysign(magnitude, rate);
+
+    bool reverse = rate < 0.0f;
+    bool wasReverse = playbackRate < 0.0f;
+    playbackRate = rate;
+    rateNumerator = std::llround(rate * PLAYBACK_RATE_DENOMINATOR);
+
+    // direction change, continue next to the shown frame
+    if (reverse != wasReverse && !dpbSlots.empty()) {
+        if (reverse) {
+            if (!playingFromCache) flushDecodeQueue();
+            seekTargetOrder = -1;
+            reverseWindowLow = -1;
+            nextPresentOrder = currentFrame == 0 ? framesCount - 1 : (uint32_t)currentFrame - 1;
+        }
+        else {
+            seekFrame(((uint32_t)currentFrame + 1) % framesCount);
+        }
+    }
+
+    resetClock();
+}
+
+void Video::setVisible(bool visible) {
+    Video::visible.store(visible, std::memory_order_relaxed);
+}
+
+void Video::updateVisibility() {
+    // shown again while playing, continue in step with the master clock,
+    // the last frame stays shown until the frame at the current time is decoded
+    bool visible = Video::visible.load(std::memory_order_relaxed);
+    if (visible && !decodeVisible && playing) seekToClock();
+    decodeVisible = visible;
+}
+
+void Video::seekToClock() {
+    // loops played while hidden, the anchor moves by whole loops so every frame keeps its master time
+    int64_t mediaTime = getMediaTime();
+    if (durationTicks > 0) {
+        int64_t loops = mediaTime / durationTicks;
+        if (mediaTime < 0 && mediaTime % durationTicks != 0) loops--;
+        anchorMediaTime -= loops * durationTicks;
+        mediaTime -= loops * durationTicks;
+    }
+
+    auto timestampIt = std::upper_bound(frames.timestamp.begin(), frames.timestamp.end(), mediaTime);
+    uint32_t displayOrder = timestampIt == frames.timestamp.begin() ? 0 : (uint32_t)(timestampIt - frames.timestamp.begin() - 1);
+
+    seekFrame(displayOrder);
+    seekKeepsClock = true;
+}
+
+void Video::resetClock() {
+    // time the next frame to present from now
+    anchorMasterTime = pMasterClock->now();
+    anchorMediaTime = frames.timestamp[nextPresentOrder];
 }
 
 void Video::firstFrame() {
+    if (!playingFromCache) flushDecodeQueue();
+
+    seekTargetOrder = -1;
+    seekPending = false;
+    seekKeepsClock = false;
+    reverseWindowLow = -1;
+    nextDecodeFrame = 0;
+    nextPresentOrder = 0;
     currentFrame = 0;
 
-    std::chrono::steady_clock::time_point currentTime = std::chrono::high_resolution_clock::now();
-    startTime = currentTime;
+    anchorMasterTime = pMasterClock->now();
+    anchorMediaTime = 0;
 
     presentAFrame = true;
 }
 
+void Video::seek(float time) {
+    // the shown frame at time is the last one with a timestamp before it
+    int64_t timestamp = std::llround((double)time * timescale);
+    auto timestampIt = std::upper_bound(frames.timestamp.begin(), frames.timestamp.end(), timestamp);
+    uint32_t displayOrder = timestampIt == frames.timestamp.begin() ? 0 : (uint32_t)(timestampIt - frames.timestamp.begin() - 1);
+
+    seekFrame(displayOrder);
+}
+
+void Video::seekFrame(uint32_t displayOrder) {
+    if (displayOrder >= framesCount) displayOrder = framesCount - 1;
+
+    seekStartTime = std::chrono::high_resolution_clock::now();
+    seekPending = true;
+    seekKeepsClock = false;
+
+    nextPresentOrder = displayOrder;
+    presentAFrame = true;
+    reverseWindowLow = -1;
+
+    // cached frames are shown without decoding
+    if (playingFromCache) return;
+
+    flushDecodeQueue();
+
+    // closest keyframe before the target in decode order
+    uint32_t targetDecodeFrame = displayToDecodeOrder[displayOrder];
+    auto keyFrameIt = std::upper_bound(keyFrames.begin(), keyFrames.end(), targetDecodeFrame);
+    nextDecodeFrame = *(keyFrameIt - 1);
+    seekTargetOrder = displayOrder;
+}
+
+void Video::finishSeek() {
+    seekPending = false;
+
+    std::chrono::steady_clock::time_point currentTime = std::chrono::high_resolution_clock::now();
+    lastSeekLatencySeconds = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - seekStartTime).count();
+
+    // playback continues from the shown target, late frames after it are dropped when the clock was kept
+    if (!seekKeepsClock) resetClock();
+    seekKeepsClock = false;
+}
+
 Video::~Video() {
-    delete pVkDecoder;
+    // destroyed once the decode thread released it, without the media lock
+    if (!dpbSlots.empty()) pDecoder->waitIdle();
+    delete pFrameCache;
+    delete pReverseWindow;
+    delete pDecodeQueue;
+    if (pStreamData != nullptr) pDecoder->unmapVideoStream();
+    delete pDecoder;
+    delete pStreamRing;
+    delete pFile;
+
+    // the stream frame is a layer of the released images
+    if (!dpbSlots.empty()) pDevice->removeVideoFrameStream(vmVideoFrameStreamId);
 }
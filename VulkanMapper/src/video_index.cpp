@@ -0,0 +1,213 @@
+#include "../include/video_index.h"
+#include "../include/video.h"
+#include "../include/mapped_file.h"
+
+#include <h264.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+struct VideoIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    // key
+    uint64_t mediaFileSize;
+    int64_t mediaModifiedTime;
+    uint32_t pathLength;            // media path follows the header
+
+    // layout guards
+    uint32_t spsSize;
+    uint32_t ppsSize;
+    uint32_t frameRowSize;          // frame table bytes per frame
+    uint32_t sliceRowSize;          // slice table bytes per slice
+    uint64_t bitStreamAlignment;    // frame offsets depend on it
+
+    // track info
+    uint32_t width;
+    uint32_t height;
+    uint32_t bitRate;
+    float averageFrameRate;
+    float durationSeconds;
+    uint32_t timescale;
+    int64_t durationTicks;
+    uint64_t bitStreamSize;
+    uint64_t maxFrameSize;
+    uint64_t maxGopSize;
+    uint32_t numDpbSlots;
+    uint32_t spsCount;
+    uint32_t ppsCount;
+    uint32_t framesCount;
+    uint32_t slicesCount;
+};
+
+static std::string getIndexPath(const std::string& filePath) {
+    return filePath + VIDEO_INDEX_EXTENSION;
+}
+
+static bool queryMediaKey(const std::string& filePath, uint64_t& fileSize, int64_t& modifiedTime) {
+    std::error_code error;
+
+    fileSize = std::filesystem::file_size(filePath, error);
+    if (error) return false;
+
+    auto writeTime = std::filesystem::last_write_time(filePath, error);
+    if (error) return false;
+    modifiedTime = (int64_t)writeTime.time_since_epoch().count();
+
+    return true;
+}
+
+bool loadVideoIndex(Video* pVideo, uint64_t bitStreamAlignment) {
+    std::string filePath = pVideo->getFilePath();
+    std::string indexPath = getIndexPath(filePath);
+
+    uint64_t mediaFileSize;
+    int64_t mediaModifiedTime;
+    if (!queryMediaKey(filePath, mediaFileSize, mediaModifiedTime)) return false;
+
+    std::error_code error;
+    if (!std::filesystem::exists(indexPath, error)) return false;
+
+    try {
+        MappedFile indexFile(indexPath);
+        if (indexFile.getSize() < sizeof(VideoIndexHeader)) return false;
+
+        VideoIndexHeader header;
+        std::memcpy(&header, indexFile.data(), sizeof(header));
+
+        if (
+            header.magic != VIDEO_INDEX_MAGIC ||
+            header.version != VIDEO_INDEX_VERSION ||
+            header.mediaFileSize != mediaFileSize ||
+            header.mediaModifiedTime != mediaModifiedTime ||
+            header.spsSize != sizeof(h264::SPS) ||
+            header.ppsSize != sizeof(h264::PPS) ||
+            header.frameRowSize != pVideo->frames.getRowSize() ||
+            header.sliceRowSize != pVideo->slices.getRowSize() ||
+            header.bitStreamAlignment != bitStreamAlignment
+            ) {
+            return false;   // stale
+        }
+
+        uint64_t spsBytes = (uint64_t)header.spsCount * sizeof(h264::SPS);
+        uint64_t ppsBytes = (uint64_t)header.ppsCount * sizeof(h264::PPS);
+        uint64_t frameTableBytes = (uint64_t)header.framesCount * header.frameRowSize;
+        uint64_t sliceTableBytes = (uint64_t)header.slicesCount * header.sliceRowSize;
+
+        if (indexFile.getSize() != sizeof(header) + header.pathLength + spsBytes + ppsBytes + frameTableBytes + sliceTableBytes) {
+            return false;   // truncated
+        }
+
+        const uint8_t* pData = indexFile.data() + sizeof(header);
+        if (std::string((const char*)pData, header.pathLength) != filePath) return false;
+        pData += header.pathLength;
+
+        pVideo->width = header.width;
+        pVideo->height = header.height;
+        pVideo->bitRate = header.bitRate;
+        pVideo->averageFrameRate = header.averageFrameRate;
+        pVideo->durationSeconds = header.durationSeconds;
+        pVideo->timescale = header.timescale;
+        pVideo->durationTicks = header.durationTicks;
+        pVideo->bitStreamSize = header.bitStreamSize;
+        pVideo->maxFrameSize = header.maxFrameSize;
+        pVideo->maxGopSize = header.maxGopSize;
+        pVideo->numDpbSlots = header.numDpbSlots;
+        pVideo->spsCount = header.spsCount;
+        pVideo->ppsCount = header.ppsCount;
+        pVideo->framesCount = header.framesCount;
+
+        pVideo->spsData.assign(pData, pData + spsBytes);
+        pData += spsBytes;
+
+        pVideo->ppsData.assign(pData, pData + ppsBytes);
+        pData += ppsBytes;
+
+        // frame & slice tables, column after column
+        auto readColumn = [&pData](auto& column) {
+            uint64_t columnBytes = column.size() * sizeof(column[0]);
+            std::memcpy(column.data(), pData, columnBytes);
+            pData += columnBytes;
+        };
+        pVideo->frames.resize(header.framesCount);
+        pVideo->frames.forEachColumn(readColumn);
+        pVideo->slices.resize(header.slicesCount);
+        pVideo->slices.forEachColumn(readColumn);
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+void saveVideoIndex(Video* pVideo, uint64_t bitStreamAlignment) {
+    std::string filePath = pVideo->getFilePath();
+    std::string indexPath = getIndexPath(filePath);
+
+    VideoIndexHeader header = {};
+    header.magic = VIDEO_INDEX_MAGIC;
+    header.version = VIDEO_INDEX_VERSION;
+    if (!queryMediaKey(filePath, header.mediaFileSize, header.mediaModifiedTime)) return;
+    header.pathLength = (uint32_t)filePath.size();
+
+    header.spsSize = sizeof(h264::SPS);
+    header.ppsSize = sizeof(h264::PPS);
+    header.frameRowSize = pVideo->frames.getRowSize();
+    header.sliceRowSize = pVideo->slices.getRowSize();
+    header.bitStreamAlignment = bitStreamAlignment;
+
+    header.width = pVideo->width;
+    header.height = pVideo->height;
+    header.bitRate = pVideo->bitRate;
+    header.averageFrameRate = pVideo->averageFrameRate;
+    header.durationSeconds = pVideo->durationSeconds;
+    header.timescale = pVideo->timescale;
+    header.durationTicks = pVideo->durationTicks;
+    header.bitStreamSize = pVideo->bitStreamSize;
+    header.maxFrameSize = pVideo->maxFrameSize;
+    header.maxGopSize = pVideo->maxGopSize;
+    header.numDpbSlots = pVideo->numDpbSlots;
+    header.spsCount = pVideo->spsCount;
+    header.ppsCount = pVideo->ppsCount;
+    header.framesCount = pVideo->framesCount;
+    header.slicesCount = pVideo->slices.count;
+
+    // write to a temporary file first, a reader never sees a partial index
+    std::string tempPath = indexPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "failed to write video index: " << indexPath << std::endl;
+            return;
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        file.write(filePath.data(), filePath.size());
+        file.write((const char*)pVideo->spsData.data(), (uint64_t)pVideo->spsCount * sizeof(h264::SPS));
+        file.write((const char*)pVideo->ppsData.data(), (uint64_t)pVideo->ppsCount * sizeof(h264::PPS));
+        auto writeColumn = [&file](auto& column) {
+            file.write((const char*)column.data(), column.size() * sizeof(column[0]));
+        };
+        pVideo->frames.forEachColumn(writeColumn);
+        pVideo->slices.forEachColumn(writeColumn);
+
+        if (!file.good()) {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            std::cerr << "failed to write video index: " << indexPath << std::endl;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, indexPath, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        std::cerr << "failed to write video index: " << indexPath << std::endl;
+    }
+}
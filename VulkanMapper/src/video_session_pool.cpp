@@ -0,0 +1,186 @@
+#include "../include/video_session_pool.h"
+#include "../include/vk_state.h"
+#include "../include/vk_video.h"
+#include "../include/vk_utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+VideoSessionPool::VideoSessionPool(VulkanState* pVkState) {
+    VideoSessionPool::pVkState = pVkState;
+}
+
+VideoSessionPool::~VideoSessionPool() {
+    for (PooledVideoSession* pSession : freeSessions) {
+        destroySession(pSession);
+    }
+    freeSessions.clear();
+}
+
+PooledVideoSession* VideoSessionPool::acquire(const VideoSessionKey& key, const VkVideoProfileInfoKHR* pVideoProfile, const VkVideoCapabilitiesKHR& videoCapabilities) {
+    // most recently released first, its memory is the most likely to be resident
+    for (auto it = freeSessions.rbegin(); it != freeSessions.rend(); it++) {
+        if ((*it)->key == key) {
+            PooledVideoSession* pSession = *it;
+            freeSessions.erase(std::next(it).base());
+
+            stats.reused++;
+            stats.free = (uint32_t)freeSessions.size();
+            return pSession;
+        }
+    }
+
+    stats.created++;
+    return createSession(key, pVideoProfile, videoCapabilities);
+}
+
+void VideoSessionPool::release(PooledVideoSession* pSession) {
+    freeSessions.push_back(pSession);
+
+    if (freeSessions.size() > VIDEO_SESSION_POOL_SIZE) {
+        destroySession(freeSessions.front());
+        freeSessions.erase(freeSessions.begin());
+    }
+
+    stats.free = (uint32_t)freeSessions.size();
+}
+
+PooledVideoSession* VideoSessionPool::createSession(const VideoSessionKey& key, const VkVideoProfileInfoKHR* pVideoProfile, const VkVideoCapabilitiesKHR& videoCapabilities) {
+    PooledVideoSession* pSession = new PooledVideoSession();
+    pSession->key = key;
+
+    // create video session
+    VkVideoSessionCreateInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_CREATE_INFO_KHR;
+    info.queueFamilyIndex = pVkState->getVideoQueueFamilyIndex();
+    info.maxActiveReferencePictures = std::min(key.dpbSlots - 1, videoCapabilities.maxActiveReferencePictures);
+    info.maxDpbSlots = key.dpbSlots;
+    info.maxCodedExtent.width = std::min(key.width, videoCapabilities.maxCodedExtent.width);
+    info.maxCodedExtent.height = std::min(key.height, videoCapabilities.maxCodedExtent.height);
+    info.pictureFormat = FRAME_FORMAT;
+    info.referencePictureFormat = info.pictureFormat;
+    info.pVideoProfile = pVideoProfile;
+    info.pStdHeaderVersion = &videoCapabilities.stdHeaderVersion;
+
+    if (vkCreateVideoSessionKHR(pVkState->getDevice(), &info, nullptr, &pSession->videoSession) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create video session");
+    }
+
+    // query memory requirements
+    uint32_t requirementsCount = 0;
+    vkGetVideoSessionMemoryRequirementsKHR(pVkState->getDevice(), pSession->videoSession, &requirementsCount, nullptr);
+    std::vector<VkVideoSessionMemoryRequirementsKHR> videoSessionRequirements(requirementsCount);
+
+    for (auto& videoSessionRequirement : videoSessionRequirements) {
+        videoSessionRequirement.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_MEMORY_REQUIREMENTS_KHR;
+    }
+
+    if (vkGetVideoSessionMemoryRequirementsKHR(pVkState->getDevice(), pSession->videoSession, &requirementsCount, videoSessionRequirements.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to get video session memory requirements");
+    }
+
+    // allocate and bind memory
+    pSession->videoSessionMemories.resize(requirementsCount);
+    for (uint32_t i = 0; i < requirementsCount; ++i) {
+        VkMemoryRequirements memoryRequirements = videoSessionRequirements[i].memoryRequirements;
+
+        // allocate memory
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memoryRequirements.size;
+
+        allocInfo.memoryTypeIndex = findGenericMemoryType(
+            pVkState->getPhysicalDevice(),
+            memoryRequirements.memoryTypeBits
+        );
+
+        if (vkAllocateMemory(pVkState->getDevice(), &allocInfo, nullptr, &pSession->videoSessionMemories[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory");
+        }
+
+        // bind memory
+        VkBindVideoSessionMemoryInfoKHR bindInfo = {};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_VIDEO_SESSION_MEMORY_INFO_KHR;
+        bindInfo.memory = pSession->videoSessionMemories[i];
+        bindInfo.memoryBindIndex = videoSessionRequirements[i].memoryBindIndex;
+        bindInfo.memoryOffset = 0;
+        bindInfo.memorySize = allocInfo.allocationSize;
+
+        if (vkBindVideoSessionMemoryKHR(pVkState->getDevice(), pSession->videoSession, 1, &bindInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind video session memory");
+        }
+    }
+
+    // dpb image
+    VkVideoProfileListInfoKHR profileListInfo = {};
+    profileListInfo.sType = VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR;
+    profileListInfo.pProfiles = pVideoProfile;
+    profileListInfo.profileCount = 1;
+
+    VkImageUsageFlags usageFlags = 0;
+    usageFlags |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    usageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;     // frame cache copies
+    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_DPB_BIT_KHR;
+    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_SRC_BIT_KHR;
+    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_DST_BIT_KHR;
+
+    pVkState->createImage(
+        key.width,
+        key.height,
+        key.dpbSlots,
+        FRAME_FORMAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        usageFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        pSession->dpbImage,
+        pSession->dpbImageMemory,
+        &profileListInfo
+    );
+
+    // no initial layout, a layer enters the dpb layout with the decode writing it
+
+    // dpb image view, all layers, and one view per decoded slot
+    pSession->decodedImageViews.resize(key.dpbSlots);
+    for (int i = -1; i < (int)key.dpbSlots; i++) {
+        VkSamplerYcbcrConversionInfo conversionInfo = {};
+        conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
+        conversionInfo.conversion = pVkState->getYcbcrSamplerConversion();
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = pSession->dpbImage;
+        viewInfo.viewType = i < 0 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = FRAME_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = i < 0 ? 0 : i;
+        viewInfo.subresourceRange.layerCount = i < 0 ? key.dpbSlots : 1;
+        viewInfo.pNext = &conversionInfo;
+
+        VkImageView* pView = i < 0 ? &pSession->dpbImageView : &pSession->decodedImageViews[i];
+        if (vkCreateImageView(pVkState->getDevice(), &viewInfo, nullptr, pView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+    }
+
+    return pSession;
+}
+
+void VideoSessionPool::destroySession(PooledVideoSession* pSession) {
+    // destroy dpb
+    vkDestroyImageView(pVkState->getDevice(), pSession->dpbImageView, nullptr);
+    for (auto decodedImageView : pSession->decodedImageViews) {
+        vkDestroyImageView(pVkState->getDevice(), decodedImageView, nullptr);
+    }
+    vkDestroyImage(pVkState->getDevice(), pSession->dpbImage, nullptr);
+    vkFreeMemory(pVkState->getDevice(), pSession->dpbImageMemory, nullptr);
+
+    // destroy video session
+    vkDestroyVideoSessionKHR(pVkState->getDevice(), pSession->videoSession, nullptr);
+    for (auto videoSessionMemory : pSession->videoSessionMemories) {
+        vkFreeMemory(pVkState->getDevice(), videoSessionMemory, nullptr);
+    }
+
+    delete pSession;
+}
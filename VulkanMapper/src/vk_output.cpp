@@ -97,7 +97,6 @@ void VulkanOutput::initSurface() {
     uint32_t queueFamilyIndices[] = { 
         graphicsFamily,
         presentFamily,
-        pApp->getVulkanState()->getVideoQueueFamilyIndex(),
     };
 
     if (graphicsFamily != presentFamily) {
@@ -421,7 +420,7 @@ void VulkanOutput::loadPipelines() {
         newPipeline.pipeline = pipeline;
         newPipeline.pipelineLayout = pipelineLayout;
 
-        pipelines.emplace(pipelinesToLoad[i].name, newPipeline);
+        pipelines.push_back(newPipeline);
     }
 }
 
@@ -441,6 +440,7 @@ void VulkanOutput::initMemory() {
     // create descriptor pool
     VkDescriptorPoolSize poolSizes[] = {
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT },
     };
 
     VkDescriptorPoolCreateInfo poolInfo = {};
@@ -500,6 +500,10 @@ void VulkanOutput::initMemory() {
 
         memcpy(uniformBuffersMapped[i], &ubo, sizeof(ubo));
     }
+
+    // geometry regions of the output frames in flight
+    pGeometry = new GeometryBuffer(pApp->getVulkanState(), MAX_FRAMES_IN_FLIGHT, pApp->getVulkanState()->getVerticesCount(), pApp->getVulkanState()->getIndicesCount());
+    pIndirectDraws = new IndirectDraws(pApp->getVulkanState(), uniformBufferSets, pApp->getVulkanState()->getIndirectDrawsCount());
 }
 
 void VulkanOutput::draw() {
@@ -522,6 +526,14 @@ void VulkanOutput::draw() {
     vkResetFences(pApp->getVulkanState()->getDevice(), 1, &inFlightFences[currentFrame]);
     vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 
+    // objects may have been added or removed after the viewport built the draw list
+    pDrawList = pApp->getVulkanState()->getDrawList();
+    if (!pDrawList->isCurrent(pApp->getScene()->getRevision())) {
+        pDrawList->build(pApp->getScene()->getObjects(), pApp->getScene()->getRevision());
+    }
+    pGeometry->update(pApp->getScene()->getObjects(), pApp->getScene()->getRevision(), currentFrame);
+    pIndirectDraws->update(pApp->getScene()->getObjects(), pDrawList, pGeometry, currentFrame);
+
     recordCommandBuffer(imageIndex);
 
     // submit command buffer
@@ -544,7 +556,15 @@ void VulkanOutput::draw() {
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(pApp->getVulkanState()->getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(pApp->getVulkanState()->getQueueMutex());
+
+    // dpb layers are not moved while decodes may access them
+    VkQueue graphicsQueue = pApp->getVulkanState()->getGraphicsQueue();
+    VkResult submitResult = samplesDpb
+        ? pApp->getVulkanState()->getDecodeScheduler()->submitDpbAccess(graphicsQueue, submitInfo, inFlightFences[currentFrame])
+        : vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+
+    if (submitResult != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
@@ -566,7 +586,7 @@ void VulkanOutput::draw() {
 }
 
 void VulkanOutput::cleanup() {
-    vkDeviceWaitIdle(pApp->getVulkanState()->getDevice());
+    pApp->getVulkanState()->waitDeviceIdle();
 
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         vkDestroyImageView(pApp->getVulkanState()->getDevice(), swapChainImageViews[i], nullptr);
@@ -589,13 +609,18 @@ void VulkanOutput::cleanup() {
         vkFreeMemory(pApp->getVulkanState()->getDevice(), uniformBuffersMemory[i], nullptr);
     }
 
+    delete pGeometry;
+    pGeometry = nullptr;
+    delete pIndirectDraws;
+    pIndirectDraws = nullptr;
+
     // destroy descriptor pools
     vkDestroyDescriptorPool(pApp->getVulkanState()->getDevice(), descriptorPool, nullptr);
 
     // destroy pipeline
     for (auto pipeline : pipelines) {
-        vkDestroyPipeline(pApp->getVulkanState()->getDevice(), pipeline.second.pipeline, nullptr);
-        vkDestroyPipelineLayout(pApp->getVulkanState()->getDevice(), pipeline.second.pipelineLayout, nullptr);
+        vkDestroyPipeline(pApp->getVulkanState()->getDevice(), pipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(pApp->getVulkanState()->getDevice(), pipeline.pipelineLayout, nullptr);
     }
     pipelines.clear();
 
@@ -634,6 +659,9 @@ void VulkanOutput::recordCommandBuffer(uint32_t imageIndex) {
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
 
+    // video frames sampled in place in the dpb
+    samplesDpb = pApp->getVulkanState()->recordVideoFrameBarriers(commandBuffers[currentFrame], true);
+
     vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     VkViewport viewport{};
@@ -651,96 +679,41 @@ void VulkanOutput::recordCommandBuffer(uint32_t imageIndex) {
     vkCmdSetScissor(commandBuffers[currentFrame], 0, 1, &scissor);
 
     // bind buffer
-    VkBuffer vertexBuffers[] = { pApp->getVulkanState()->getVertexBuffer() };
+    VkBuffer vertexBuffers[] = { pGeometry->getVertexBuffer(currentFrame) };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(commandBuffers[currentFrame], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffers[currentFrame], pApp->getVulkanState()->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
-
-    // looping objects
-    auto object_ids = pApp->getScene()->getIds();
-    uint32_t indexOffset = 0;
-
-    for (auto object_id : object_ids) {
-        auto object = pApp->getScene()->getObjectPointer(object_id);
-
-        std::string pipelineName = object->getPipelineName();
-        VkPipeline pipeline = pipelines[pipelineName].pipeline;
-        VkPipelineLayout pipelineLayout = pipelines[pipelineName].pipelineLayout;
-        std::vector<uint16_t> objectIndices = object->getIndices();
-        uint32_t indexCount = objectIndices.size();
-        
-        // bind pipeline
-        vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-        vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &uniformBufferSets[currentFrame], 0, nullptr);
-
-        // bind texture
-        if (pipelineName == "texture") {
-            auto plane = dynamic_cast<Plane*>(object);
-            if (plane != nullptr) {
-                VkDescriptorSet descriptorSet = pApp->getVulkanState()->getTexture(plane->getMediaId())->descriptorSet;
-                vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorSet, 0, nullptr);
-            }
-
-            // draw
-            vkCmdDrawIndexed(commandBuffers[currentFrame], indexCount, 1, indexOffset, 0, 0);
-        }
-
-        // bind video frame
-        if (pipelineName == "video_frame") {
-            auto pPlane = dynamic_cast<Plane*>(object);
-            if (pPlane == nullptr) break;
+    vkCmdBindIndexBuffer(commandBuffers[currentFrame], pGeometry->getIndexBuffer(currentFrame), 0, pGeometry->getIndexType(currentFrame));
 
-            Media* pMedia = pApp->getMediaManager()->getMediaById(pPlane->getMediaId());
-            //if (pMedia->type != MediaType::VIDEO) break;
+    // one indirect draw per batch of the viewport draw list, the output only shows media
+    PipelineId boundPipeline = PipelinesCount;  // none
 
-            Video* pVideo = dynamic_cast<Video*>(pMedia);
-            if (pVideo == nullptr) break;
+    for (const DrawBatch& batch : pIndirectDraws->getBatches()) {
+        if (batch.pipelineId != TexturePipeline && batch.pipelineId != VideoFramePipeline) continue;
 
-            VmVideoFrameStream* pVideoStream = pApp->getVulkanState()->getVideoFrameStream(pVideo->getVmVideoFrameStreamId());
-            if (pVideoStream == nullptr) break;
+        Pipeline& pipeline = pipelines[batch.pipelineId];
 
-            if (pVideoStream->outImageViewsInFlight[currentFrame] != pVideoStream->frameImageView) {
-                VkDescriptorImageInfo imageInfo{};
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageInfo.imageView = pVideoStream->frameImageView;
-                imageInfo.sampler = pApp->getVulkanState()->getYcbcrFrameSampler();
+        if (batch.pipelineId != boundPipeline) {
+            vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+            vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 1, &uniformBufferSets[currentFrame], 0, nullptr);
 
-                VkWriteDescriptorSet descriptorWrites{};
-                descriptorWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites.dstSet = pVideoStream->outDescriptorSetsInFlight[currentFrame];
-                descriptorWrites.dstBinding = 0;
-                descriptorWrites.dstArrayElement = 0;
-                descriptorWrites.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites.descriptorCount = 1;
-                descriptorWrites.pImageInfo = &imageInfo;
-                descriptorWrites.pNext = nullptr;
-
-                vkUpdateDescriptorSets(pApp->getVulkanState()->getDevice(), 1, &descriptorWrites, 0, nullptr);   // executed immediately
-
-                pVideoStream->outImageViewsInFlight[currentFrame] = pVideoStream->frameImageView;
+            if (batch.pipelineId == TexturePipeline) {
+                VkDescriptorSet textureArraySet = pApp->getVulkanState()->getTextureArraySet();
+                vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 1, 1, &textureArraySet, 0, nullptr);
             }
 
-            vkCmdBindDescriptorSets(
-                commandBuffers[currentFrame],
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                pipelineLayout,
-                1,
-                1,
-                &(pVideoStream->outDescriptorSetsInFlight[currentFrame]),
-                0,
-                nullptr
-            );
-            
-            // draw
-            vkCmdDrawIndexed(commandBuffers[currentFrame], indexCount, 1, indexOffset, 0, 0);
+            boundPipeline = batch.pipelineId;
         }
 
-        
-        indexOffset += objectIndices.size();
+        // video frame, skipped while the video has no frame yet
+        if (batch.pipelineId == VideoFramePipeline && !pApp->getVulkanState()->pushVideoFrame(commandBuffers[currentFrame], pipeline.pipelineLayout, batch.materialId)) continue;
+
+        pIndirectDraws->record(commandBuffers[currentFrame], batch, currentFrame);
     }
 
     vkCmdEndRenderPass(commandBuffers[currentFrame]);
 
+    if (samplesDpb) pApp->getVulkanState()->recordVideoFrameBarriers(commandBuffers[currentFrame], false);
+
     if (vkEndCommandBuffer(commandBuffers[currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
@@ -754,7 +727,7 @@ void VulkanOutput::recreateSwapChain() {
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
     }
-    vkDeviceWaitIdle(pApp->getVulkanState()->getDevice());
+    pApp->getVulkanState()->waitDeviceIdle();
 
     // clenup swapchain
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
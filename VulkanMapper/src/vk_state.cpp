@@ -2,6 +2,7 @@
 #include <iostream>
 #include <set>
 #include <map>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_FORCE_RADIANS
@@ -21,6 +22,7 @@
 #include "../include/ui.h"
 #include "../include/media_manager.h"
 #include "../include/vk_video.h"
+#include "../include/image.h"
 
 
 VulkanState::VulkanState(App* pApp) {
@@ -37,11 +39,13 @@ void VulkanState::init() {
     initVulkan();
 }
 
-VkCommandBuffer VulkanState::beginSingleTimeCommands() {
+VkCommandBuffer VulkanState::beginSingleTimeCommands(VkCommandPool pool) {
+    if (pool == VK_NULL_HANDLE) pool = commandPool;
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
+    allocInfo.commandPool = pool;
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer commandBuffer;
@@ -56,7 +60,9 @@ VkCommandBuffer VulkanState::beginSingleTimeCommands() {
     return commandBuffer;
 }
 
-void VulkanState::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+void VulkanState::endSingleTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool pool) {
+    if (pool == VK_NULL_HANDLE) pool = commandPool;
+
     vkEndCommandBuffer(commandBuffer);
 
     VkSubmitInfo submitInfo{};
@@ -64,10 +70,28 @@ void VulkanState::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    // wait on a fence, not the queue, the other thread keeps submitting meanwhile
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+    }
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    vkDestroyFence(device, fence, nullptr);
+    vkFreeCommandBuffers(device, pool, 1, &commandBuffer);
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+void VulkanState::waitDeviceIdle() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    vkDeviceWaitIdle(device);
 }
 
 void VulkanState::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -205,11 +229,10 @@ int VulkanState::rateDeviceSuitability(VkPhysicalDevice device) {
     // Check device supported queues
     auto graphicsFamily = queryGraphicsQueueFamily(device);
     auto presentFamily = queryPresentQueueFamily(device, surface);
-    auto videoFamily = queryGraphicsQueueFamily(device);
-    bool completeIndicies = graphicsFamily.has_value() && presentFamily.has_value() && videoFamily.has_value();
+    bool completeIndicies = graphicsFamily.has_value() && presentFamily.has_value();
     
     // check extension
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
+    bool extensionsSupported = checkDeviceExtensionSupport(device, deviceExtensions);
 
     // Swap chain support
     bool swapChainAdequate = false;
@@ -223,9 +246,19 @@ int VulkanState::rateDeviceSuitability(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+    // vulkan 1.3 features (synchronization2, video decode barriers)
+    VkPhysicalDeviceVulkan13Features supported13Features = {};
+    supported13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    // vulkan 1.2 features (timeline semaphores, descriptor indexing)
+    VkPhysicalDeviceVulkan12Features supported12Features = {};
+    supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supported12Features.pNext = &supported13Features;
+
     // vulkan 1.1 features (ycbcr sampler)
     VkPhysicalDeviceVulkan11Features supported11Features = {};
     supported11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    supported11Features.pNext = &supported12Features;
 
     VkPhysicalDeviceFeatures2 supported2Features = {};
     supported2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
@@ -240,21 +273,40 @@ int VulkanState::rateDeviceSuitability(VkPhysicalDevice device) {
         !swapChainAdequate ||
         !supportedFeatures.samplerAnisotropy ||
         !supportedFeatures.wideLines ||
-        !supported11Features.samplerYcbcrConversion
+        !supportedFeatures.multiDrawIndirect ||
+        !supportedFeatures.drawIndirectFirstInstance ||
+        !supported11Features.samplerYcbcrConversion ||
+        !supported13Features.synchronization2 ||
+        !supported12Features.timelineSemaphore ||
+        !supported12Features.runtimeDescriptorArray ||
+        !supported12Features.descriptorBindingPartiallyBound ||
+        !supported12Features.descriptorBindingVariableDescriptorCount ||
+        !supported12Features.descriptorBindingSampledImageUpdateAfterBind ||
+        !supported12Features.descriptorBindingUpdateUnusedWhilePending ||
+        !supported12Features.shaderSampledImageArrayNonUniformIndexing
         )
         return 0;
 
+    // hardware video decode is preferred
+    if (checkVideoDecodeSupport(device)) {
+        score += 10000;
+    }
+
     return score;
 }
 
-bool VulkanState::checkDeviceExtensionSupport(VkPhysicalDevice device) {
+bool VulkanState::checkVideoDecodeSupport(VkPhysicalDevice device) {
+    return queryVideoQueueFamily(device).has_value() && checkDeviceExtensionSupport(device, videoDecodeExtensions);
+}
+
+bool VulkanState::checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -303,6 +355,11 @@ void VulkanState::pickPhysicalDevice() {
         VkPhysicalDeviceProperties pProperties;
         vkGetPhysicalDeviceProperties(physicalDevice, &pProperties);
         std::cout << pProperties.deviceName << " has been selected with " << candidates.rbegin()->first << " score" << std::endl;
+
+        videoDecodeSupported = checkVideoDecodeSupport(physicalDevice);
+        if (!videoDecodeSupported) {
+            std::cout << "no video decode queue, videos are decoded on the cpu" << std::endl;
+        }
     }
     else {
         throw std::runtime_error("failed to find a suitable GPU!");
@@ -313,9 +370,12 @@ void VulkanState::createLogicalDevice() {
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {
         graphicsFamily.value(),
-        presentFamily.value(),
-        videoFamily.value()
+        presentFamily.value()
     };
+    if (videoDecodeSupported) uniqueQueueFamilies.insert(videoFamily.value());
+
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    if (videoDecodeSupported) enabledExtensions.insert(enabledExtensions.end(), videoDecodeExtensions.begin(), videoDecodeExtensions.end());
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -330,18 +390,38 @@ void VulkanState::createLogicalDevice() {
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.wideLines = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = VK_TRUE;             // a draw batch is one indirect draw
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;     // first instance indexes the instance data
+
+    VkPhysicalDeviceVulkan13Features device13Features = {};
+    device13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    device13Features.synchronization2 = VK_TRUE;    // dpb barriers on the video decode stage
+
+    VkPhysicalDeviceVulkan12Features device12Features = {};
+    device12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    device12Features.timelineSemaphore = VK_TRUE;   // video decode completion
+    device12Features.pNext = &device13Features;
+
+    // texture array
+    device12Features.runtimeDescriptorArray = VK_TRUE;
+    device12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    device12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    device12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    device12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    device12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
 
     VkPhysicalDeviceVulkan11Features device11Features = {};
     device11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
     device11Features.samplerYcbcrConversion = VK_TRUE;
+    device11Features.pNext = &device12Features;
 
     // Creating logical device
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -361,7 +441,7 @@ void VulkanState::createLogicalDevice() {
 
     vkGetDeviceQueue(device, graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentFamily.value(), 0, &presentQueue);
-    vkGetDeviceQueue(device, videoFamily.value(), 0, &videoQueue);
+    if (videoDecodeSupported) vkGetDeviceQueue(device, videoFamily.value(), 0, &videoQueue);
 }
 
 void VulkanState::createSwapChain() {
@@ -426,7 +506,7 @@ void VulkanState::createSwapChain() {
 void VulkanState::queryQueueFamilies() {
     graphicsFamily = queryGraphicsQueueFamily(physicalDevice);
     presentFamily = queryPresentQueueFamily(physicalDevice, surface);
-    videoFamily = queryVideoQueueFamily(physicalDevice);
+    if (videoDecodeSupported) videoFamily = queryVideoQueueFamily(physicalDevice);
 }
 
 void VulkanState::createImageViews() {
@@ -656,7 +736,7 @@ void VulkanState::loadPipelines() {
         new_pipeline.pipeline = pipeline;
         new_pipeline.pipelineLayout = pipelineLayout;
 
-        pipelines.emplace(pipelinesToLoad[i].name, new_pipeline);
+        pipelines.push_back(new_pipeline);
     }
 }
 
@@ -696,6 +776,11 @@ void VulkanState::createCommandPools() {
         throw std::runtime_error("failed to create command pool!");
     }
 
+    // graphics command pool of the decode thread
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &decodeCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+
     // graphics command buffer
     commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
@@ -710,6 +795,8 @@ void VulkanState::createCommandPools() {
     }
 
     // video command pool
+    if (!videoDecodeSupported) return;
+
     poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
@@ -742,6 +829,9 @@ void VulkanState::renderViewportFrame(VkCommandBuffer commandBuffer, uint32_t im
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
 
+    // video frames sampled in place in the dpb
+    viewportSamplesDpb = recordVideoFrameBarriers(commandBuffer, true);
+
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     VkViewport viewport{};
@@ -759,89 +849,42 @@ void VulkanState::renderViewportFrame(VkCommandBuffer commandBuffer, uint32_t im
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
     // bind buffer
-    VkBuffer vertexBuffers[] = { vertexBuffer };
+    VkBuffer vertexBuffers[] = { pGeometry->getVertexBuffer(currentFrame) };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdBindIndexBuffer(commandBuffer, pGeometry->getIndexBuffer(currentFrame), 0, pGeometry->getIndexType(currentFrame));
 
-    // looping objects
-    std::string lastPipelineName = "";
+    // one indirect draw per batch, in draw order, the pipeline is bound when it changes
+    PipelineId boundPipeline = PipelinesCount;  // none
 
-    auto object_ids = pApp->getScene()->getIds();
-    uint32_t indexOffset = 0;
+    for (const DrawBatch& batch : pIndirectDraws->getBatches()) {
+        Pipeline& pipeline = pipelines[batch.pipelineId];
 
-    for (auto object_id : object_ids) {
-        auto object = pApp->getScene()->getObjectPointer(object_id);
-
-        // bind new pipeline if needed
-        std::string pipelineName = object->getPipelineName();
-        if (pipelineName != lastPipelineName) {
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipelineName].pipeline);
-
-            // bind vertex and index buffer to new pipeline
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipelineName].pipelineLayout, 0, 1, &uniformBufferSets[currentFrame], 0, nullptr);
-            lastPipelineName = pipelineName;
-        }
+        if (batch.pipelineId != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 1, &uniformBufferSets[currentFrame], 0, nullptr);
 
-        // bind texture
-        if (pipelineName == "texture") {
-            auto plane = dynamic_cast<Plane*>(object);
-            if (plane != nullptr) {
-                VmTexture texture = textures[plane->getMediaId()];
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipelineName].pipelineLayout, 1, 1, &texture.descriptorSet, 0, nullptr);
+            if (batch.pipelineId == TexturePipeline) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 1, 1, &textureArraySet, 0, nullptr);
             }
-        }
 
-        // bind video frame
-        if (pipelineName == "video_frame") {
-            auto pPlane = dynamic_cast<Plane*>(object);
-            if (pPlane == nullptr) break;
-            
-            Media* pMedia = pApp->getMediaManager()->getMediaById(pPlane->getMediaId());
-            //if (pMedia->type != MediaType::VIDEO) break;
-            
-            Video* pVideo =  dynamic_cast<Video*>(pMedia);
-            if (pVideo == nullptr) break;
-
-            auto& vmVideoFrameStream = vmVideoFrameStreams[pVideo->getVmVideoFrameStreamId()];
-
-            if (vmVideoFrameStream.vpImageViewsInFlight[currentFrame] != vmVideoFrameStream.frameImageView) {
-                VkDescriptorImageInfo imageInfo{};
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageInfo.imageView = vmVideoFrameStream.frameImageView;
-                imageInfo.sampler = ycbcrFrameSampler;
-
-                VkWriteDescriptorSet descriptorWrites{};
-                descriptorWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites.dstSet = vmVideoFrameStream.vpDescriptorSetsInFlight[currentFrame];
-                descriptorWrites.dstBinding = 0;
-                descriptorWrites.dstArrayElement = 0;
-                descriptorWrites.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites.descriptorCount = 1;
-                descriptorWrites.pImageInfo = &imageInfo;
-                descriptorWrites.pNext = nullptr;
-
-                vkUpdateDescriptorSets(device, 1, &descriptorWrites, 0, nullptr);   // executed immediately
-
-                vmVideoFrameStream.vpImageViewsInFlight[currentFrame] = vmVideoFrameStream.frameImageView;
+            if (batch.pipelineId == LinePipeline) {
+                vkCmdSetLineWidth(commandBuffer, 4.0f);
             }
-            
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipelineName].pipelineLayout, 1, 1, &vmVideoFrameStream.vpDescriptorSetsInFlight[currentFrame], 0, nullptr);
-        }
 
-        if (pipelineName == "line") {
-            vkCmdSetLineWidth(commandBuffer, 4.0f);
+            boundPipeline = batch.pipelineId;
         }
 
-        // draw
-        std::vector<uint16_t> object_indices = object->getIndices();
-        uint32_t indexCount = object_indices.size();
-        vkCmdDrawIndexed(commandBuffer, indexCount, 1, indexOffset, 0, 0);
-        indexOffset += object_indices.size();
+        // video frame, skipped while the video has no frame yet
+        if (batch.pipelineId == VideoFramePipeline && !pushVideoFrame(commandBuffer, pipeline.pipelineLayout, batch.materialId)) continue;
+
+        pIndirectDraws->record(commandBuffer, batch, currentFrame);
     }
 
     vkCmdEndRenderPass(commandBuffer);
 
+    if (viewportSamplesDpb) recordVideoFrameBarriers(commandBuffer, false);
+
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
@@ -880,7 +923,7 @@ void VulkanState::recreateSwapChain() {
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
+    waitDeviceIdle();
 
     cleanupSwapChain();
 
@@ -1248,87 +1291,6 @@ void VulkanState::createSamplers() {
     }
 }
 
-void VulkanState::createVertexBuffer() {
-    int vertices_size = 0;
-    std::vector<Vertex> vertices;
-    
-    auto object_ids = pApp->getScene()->getIds();
-
-    for (auto object_id : object_ids) {
-        std::vector<Vertex> obj_vertices = pApp->getScene()->getObjectPointer(object_id)->getVertices();
-
-        vertices_size += obj_vertices.size() * sizeof(obj_vertices[0]);
-        vertices.insert(vertices.end(), obj_vertices.begin(), obj_vertices.end());
-    }
-
-    // create buffer
-    VkDeviceSize bufferSize = sizeof(Vertex) * VERTICES_COUNT;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, nullptr);
-
-    // return if no data to transfer
-    if (vertices_size == 0) return;
-
-    // transfer vertices
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, nullptr);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
-void VulkanState::createIndexBuffer() {
-    int indices_size = 0;
-    std::vector<uint16_t> indices;
-    
-    int offset = 0;
-    auto object_ids = pApp->getScene()->getIds();
-
-    for (auto object_id : object_ids) {
-        std::vector<uint16_t> obj_indices = pApp->getScene()->getObjectPointer(object_id)->getIndices();
-
-        // sum offset
-        for (auto index = obj_indices.begin(); index != obj_indices.end(); index++) {
-            *index += offset;
-        }
-
-        indices_size += obj_indices.size() * sizeof(obj_indices[0]);
-        indices.insert(indices.end(), obj_indices.begin(), obj_indices.end());
-
-        offset += pApp->getScene()->getObjectPointer(object_id)->getVertices().size();
-    }
-
-    // create buffer
-    VkDeviceSize bufferSize = sizeof(uint16_t) * INDICES_COUNT;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, nullptr);
-
-    // return if no data to transfer
-    if (indices_size == 0) return;
-
-    // transfer indices
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, nullptr);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
 void VulkanState::createDescriptorSetLayouts() {
     // uniform buffer layout
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
@@ -1337,33 +1299,76 @@ void VulkanState::createDescriptorSetLayouts() {
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+    // instance data of the indirect draws
+    VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+    instanceLayoutBinding.binding = 1;
+    instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    instanceLayoutBinding.descriptorCount = 1;
+    instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> uniformBufferBindings = { uboLayoutBinding, instanceLayoutBinding };
     
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(uniformBufferBindings.size());
+    layoutInfo.pBindings = uniformBufferBindings.data();
 
     if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &uniformBufferLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
 
-    // texture layout
-    VkDescriptorSetLayoutBinding textureLayoutBinding{};
-    textureLayoutBinding.binding = 0;
-    textureLayoutBinding.descriptorCount = 1;
-    textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    textureLayoutBinding.pImmutableSamplers = nullptr;
-    textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    // texture array layout, sized by the device
+    VkPhysicalDeviceVulkan12Properties properties12 = {};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &properties12;
+
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+    texturesCapacity = std::min({
+        MAX_TEXTURES_COUNT,
+        properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+        properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+        properties12.maxDescriptorSetUpdateAfterBindSamplers,
+        properties12.maxPerStageUpdateAfterBindResources,
+    });
+
+    VkDescriptorSetLayoutBinding textureArrayLayoutBinding{};
+    textureArrayLayoutBinding.binding = 0;
+    textureArrayLayoutBinding.descriptorCount = texturesCapacity;
+    textureArrayLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureArrayLayoutBinding.pImmutableSamplers = nullptr;
+    textureArrayLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // elements of removed textures are left unwritten, new ones are written while frames using others are in flight
+    VkDescriptorBindingFlags textureArrayBindingFlags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &textureArrayBindingFlags;
 
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
     layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &textureLayoutBinding;
+    layoutInfo.pBindings = &textureArrayLayoutBinding;
+    layoutInfo.pNext = &bindingFlagsInfo;
 
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &textureLayout) != VK_SUCCESS) {
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &textureArrayLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
 
     // video frame layout
+    // a ycbcr sampler can't be indexed dynamically, the frame of each video is pushed when drawn
     VkDescriptorSetLayoutBinding videoFrameLayoutBinding{};
     videoFrameLayoutBinding.binding = 0;
     videoFrameLayoutBinding.descriptorCount = 1;
@@ -1372,8 +1377,10 @@ void VulkanState::createDescriptorSetLayouts() {
     videoFrameLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
     layoutInfo.bindingCount = 1;
     layoutInfo.pBindings = &videoFrameLayoutBinding;
+    layoutInfo.pNext = nullptr;
 
     if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &videoFrameLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
@@ -1397,19 +1404,33 @@ void VulkanState::createUniformBuffers() {
 void VulkanState::createDescriptorPool() {
     VkDescriptorPoolSize pool_sizes[] = {
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT },
     };
 
     VkDescriptorPoolCreateInfo pool_info = {};
     pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    pool_info.maxSets = 1000;
+    pool_info.maxSets = MAX_FRAMES_IN_FLIGHT;
     pool_info.poolSizeCount = std::size(pool_sizes);
     pool_info.pPoolSizes = pool_sizes;
 
     if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
+
+    // texture array
+    VkDescriptorPoolSize textureArrayPoolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturesCapacity };
+
+    VkDescriptorPoolCreateInfo textureArrayPoolInfo = {};
+    textureArrayPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    textureArrayPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    textureArrayPoolInfo.maxSets = 1;
+    textureArrayPoolInfo.poolSizeCount = 1;
+    textureArrayPoolInfo.pPoolSizes = &textureArrayPoolSize;
+
+    if (vkCreateDescriptorPool(device, &textureArrayPoolInfo, nullptr, &textureArrayPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
 }
 
 void VulkanState::createStaticDescriptorSets() {
@@ -1428,6 +1449,25 @@ void VulkanState::createStaticDescriptorSets() {
         }
     }
 
+    // texture array, shared by the viewport and the output
+    {
+        VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+        variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+        variableCountInfo.descriptorSetCount = 1;
+        variableCountInfo.pDescriptorCounts = &texturesCapacity;
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = textureArrayPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &textureArrayLayout;
+        allocInfo.pNext = &variableCountInfo;
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, &textureArraySet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+    }
+
     // binding
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         VkDescriptorBufferInfo bufferInfo{};
@@ -1556,11 +1596,15 @@ void VulkanState::initVulkan() {
 
     //createFramebuffers(swapChainFramebuffers, renderPass);
     createCommandPools();
-    createVertexBuffer();
-    createIndexBuffer();
+    if (videoDecodeSupported) {
+        pDecodeScheduler = new DecodeScheduler(this);
+        pVideoSessionPool = new VideoSessionPool(this);
+    }
+    pGeometry = new GeometryBuffer(this, MAX_FRAMES_IN_FLIGHT, VERTICES_COUNT, INDICES_COUNT);
     createUniformBuffers();
     createDescriptorPool();
     createStaticDescriptorSets();
+    pIndirectDraws = new IndirectDraws(this, uniformBufferSets, INDIRECT_DRAWS_COUNT);
 
     initViewportRender();
     loadPipelines();
@@ -1581,84 +1625,6 @@ void VulkanState::updateUniformBuffer(uint32_t currentImage) {
     memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
 
-void VulkanState::updateVertexBuffer() {
-    /*
-    static auto startTime = std::chrono::high_resolution_clock::now();
-
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    */
-
-    // generate vertex vector to transfer
-    int vertices_size = 0;
-    std::vector<Vertex> vertices;
-
-    auto object_ids = pApp->getScene()->getIds();
-    for (auto object_id : object_ids) {
-        std::vector<Vertex> obj_vertices = pApp->getScene()->getObjectPointer(object_id)->getVertices();
-
-        vertices_size += obj_vertices.size() * sizeof(obj_vertices[0]);
-        vertices.insert(vertices.end(), obj_vertices.begin(), obj_vertices.end());
-    }
-
-    if (vertices_size == 0) return;
-
-    VkDeviceSize bufferSize = vertices_size;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, nullptr);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
-void VulkanState::updateIndexBuffer() {
-    int indices_size = 0;
-    std::vector<uint16_t> indices;
-
-    int offset = 0;
-    auto object_ids = pApp->getScene()->getIds();
-    for (auto object_id : object_ids) {
-        std::vector<uint16_t> obj_indices = pApp->getScene()->getObjectPointer(object_id)->getIndices();
-
-        // sum offset
-        for (auto index = obj_indices.begin(); index != obj_indices.end(); index++) {
-            *index += offset;
-        }
-
-        indices_size += obj_indices.size() * sizeof(obj_indices[0]);
-        indices.insert(indices.end(), obj_indices.begin(), obj_indices.end());
-
-        offset += pApp->getScene()->getObjectPointer(object_id)->getVertices().size();
-    }
-
-    if (indices_size == 0) return;
-
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, nullptr);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
 void VulkanState::drawFrame() {
     // wait for previous frame
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
@@ -1710,7 +1676,15 @@ void VulkanState::drawFrame() {
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    // dpb layers are not moved while decodes may access them
+    VkResult submitResult = viewportSamplesDpb
+        ? pDecodeScheduler->submitDpbAccess(graphicsQueue, submitInfo, inFlightFences[currentFrame])
+        : vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+    viewportSamplesDpb = false;
+
+    if (submitResult != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
@@ -1788,21 +1762,19 @@ void VulkanState::cleanup() {
 
     // Destroy descriptor pools
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, textureArrayPool, nullptr);
 
     // destroy descriptor set layouts
-    vkDestroyDescriptorSetLayout(device, textureLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, textureArrayLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, videoFrameLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, uniformBufferLayout, nullptr);
 
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
-
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    delete pGeometry;
+    delete pIndirectDraws;
 
     for (auto pipeline : pipelines) {
-        vkDestroyPipeline(device, pipeline.second.pipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipeline.second.pipelineLayout, nullptr);
+        vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipeline.pipelineLayout, nullptr);
     }
     
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -1811,8 +1783,13 @@ void VulkanState::cleanup() {
         vkDestroyFence(device, inFlightFences[i], nullptr);
     }
     
+    // destroy decode scheduler & pooled video sessions
+    delete pDecodeScheduler;
+    delete pVideoSessionPool;
+
     // destroy command buffers
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, decodeCommandPool, nullptr);
     vkDestroyCommandPool(device, videoCommandPool, nullptr);
 
     vkDestroyDevice(device, nullptr);
@@ -2065,7 +2042,7 @@ void VulkanState::imGuiCleanup() {
 }
 
 VmTexture* VulkanState::getTexture(VmTextureId_t textureId) {
-    for (auto texture : textures) {
+    for (auto& texture : textures) {
         if (texture.id == textureId) {
             return &texture;
         }
@@ -2074,11 +2051,81 @@ VmTexture* VulkanState::getTexture(VmTextureId_t textureId) {
     return nullptr;
 }
 
-Pipeline VulkanState::getPipeline(std::string pipelineName) {
-    return pipelines[pipelineName];
+
+bool VulkanState::pushVideoFrame(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int mediaId) {
+    Video* pVideo = dynamic_cast<Video*>(pApp->getMediaManager()->getMediaById(mediaId));
+    if (pVideo == nullptr) return false;
+
+    VmVideoFrameStream* pStream = getVideoFrameStream(pVideo->getVmVideoFrameStreamId());
+    if (pStream == nullptr || pStream->frame.view == VK_NULL_HANDLE) return false;
+
+    // recorded in the command buffer, no set to allocate or keep per frame in flight
+    // dpb frames were moved to the shader read layout by recordVideoFrameBarriers
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = pStream->frame.view;
+    imageInfo.sampler = VK_NULL_HANDLE;     // immutable
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorWrite);
+
+    return true;
+}
+
+bool VulkanState::recordVideoFrameBarriers(VkCommandBuffer commandBuffer, bool toSample) {
+    videoFrameBarriers.clear();
+
+    for (const VmVideoFrameStream& stream : vmVideoFrameStreams) {
+        const VmVideoFrame& frame = stream.frame;
+        if (frame.image == VK_NULL_HANDLE || frame.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) continue;
+
+        // the decodes writing the layer and the ones reading it are ordered by the submit semaphores
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = toSample ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.srcAccessMask = 0;
+        barrier.dstStageMask = toSample ? VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = toSample ? VK_ACCESS_2_SHADER_SAMPLED_READ_BIT : 0;
+        barrier.oldLayout = toSample ? frame.layout : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = toSample ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : frame.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = frame.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = frame.layer;
+        barrier.subresourceRange.layerCount = 1;
+        videoFrameBarriers.push_back(barrier);
+    }
+
+    if (videoFrameBarriers.empty()) return false;
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = (uint32_t)videoFrameBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = videoFrameBarriers.data();
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    return true;
 }
 
 VmTextureId_t VulkanState::loadTexture(unsigned char* pixels, int width, int height) {
+    // find new id, the lowest free element of the texture array
+    VmTextureId_t newId = 0;
+    while (getTexture(newId) != nullptr) newId++;
+
+    if (newId >= texturesCapacity) {
+        throw std::runtime_error("texture array is full!");
+    }
+
     VkDeviceSize imageSize = width * height * 4;
 
     // transfer image
@@ -2104,21 +2151,9 @@ VmTextureId_t VulkanState::loadTexture(unsigned char* pixels, int width, int hei
     vkDestroyBuffer(device, stagingBuffer, nullptr);
     vkFreeMemory(device, stagingBufferMemory, nullptr);
 
-    // create descriptor set
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &textureLayout;
-
-    VkDescriptorSet descriptor_set;
-    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptor_set) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate descriptor sets!");
-    }
-
     VkImageView image_view = createImageView(texture_image, VK_FORMAT_R8G8B8A8_SRGB, nullptr);
 
-    // binding
+    // binding, the element isn't used by frames in flight
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imageInfo.imageView = image_view;
@@ -2126,29 +2161,20 @@ VmTextureId_t VulkanState::loadTexture(unsigned char* pixels, int width, int hei
 
     VkWriteDescriptorSet descriptor_writes{};
     descriptor_writes.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptor_writes.dstSet = descriptor_set;
+    descriptor_writes.dstSet = textureArraySet;
     descriptor_writes.dstBinding = 0;
-    descriptor_writes.dstArrayElement = 0;
+    descriptor_writes.dstArrayElement = newId;
     descriptor_writes.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptor_writes.descriptorCount = 1;
     descriptor_writes.pImageInfo = &imageInfo;
 
     vkUpdateDescriptorSets(device, 1, &descriptor_writes, 0, nullptr);
 
-    // find new id
-    VmTextureId_t newId = 0;
-    for (auto texture : textures) {
-        if (texture.id >= newId) {
-            newId = texture.id + 1;
-        }
-    }
-
     VmTexture newTexture{};
     newTexture.id = newId;
     newTexture.image = texture_image;
     newTexture.imageMemory = texture_image_memory;
     newTexture.imageView = image_view;
-    newTexture.descriptorSet = descriptor_set;
     newTexture.width = width;
     newTexture.height = height;
 
@@ -2160,7 +2186,7 @@ VmTextureId_t VulkanState::loadTexture(unsigned char* pixels, int width, int hei
 void VulkanState::destroyTexture(VmTextureId_t textureId) {
     for (size_t i = 0; i < textures.size(); i++) {
         if (textures[i].id == textureId) {
-            vkDeviceWaitIdle(device);
+            waitDeviceIdle();
             vkDestroyImageView(device, textures[i].imageView, nullptr);
             vkDestroyImage(device, textures[i].image, nullptr);
             vkFreeMemory(device, textures[i].imageMemory, nullptr);
@@ -2183,36 +2209,6 @@ VmVideoFrameStreamId_t VulkanState::createVideoFrameStream() {
     VmVideoFrameStream videoFrameStream = {};
     videoFrameStream.id = newId;
 
-    videoFrameStream.vpDescriptorSetsInFlight.resize(MAX_FRAMES_IN_FLIGHT);
-
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorSetAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = 1;
-        allocInfo.pSetLayouts = &videoFrameLayout;
-
-        if (vkAllocateDescriptorSets(device, &allocInfo, &videoFrameStream.vpDescriptorSetsInFlight[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate descriptor sets!");
-        }
-    }
-
-    videoFrameStream.outDescriptorSetsInFlight.resize(pApp->getOutput()->getFramesInFlight());
-    for (int i = 0; i < pApp->getOutput()->getFramesInFlight(); i++) {
-        VkDescriptorSetAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = 1;
-        allocInfo.pSetLayouts = &videoFrameLayout;
-
-        if (vkAllocateDescriptorSets(device, &allocInfo, &videoFrameStream.outDescriptorSetsInFlight[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate descriptor sets!");
-        }
-    }
-
-    videoFrameStream.vpImageViewsInFlight.resize(MAX_FRAMES_IN_FLIGHT);
-    videoFrameStream.outImageViewsInFlight.resize(MAX_FRAMES_IN_FLIGHT);
-
     vmVideoFrameStreams.push_back(videoFrameStream);
 
     return newId;
@@ -2236,11 +2232,11 @@ void VulkanState::removeVideoFrameStream(VmVideoFrameStreamId_t streamId) {
     }
 }
 
-void VulkanState::loadVideoFrame(VmVideoFrameStreamId_t vmVideoFrameStreamId, VkImageView videoFrameView) {
+void VulkanState::loadVideoFrame(VmVideoFrameStreamId_t vmVideoFrameStreamId, const VmVideoFrame& videoFrame) {
     // search if already exist
     for (auto& vmVideoFrameStream : vmVideoFrameStreams) {
         if (vmVideoFrameStream.id == vmVideoFrameStreamId) {
-            vmVideoFrameStream.frameImageView = videoFrameView;
+            vmVideoFrameStream.frame = videoFrame;
             return;
         }
     }
@@ -2272,9 +2268,12 @@ VkDescriptorSet VulkanState::renderViewport(uint32_t viewportWidth, uint32_t vie
         recreateViewportSurface(viewportWidth, viewportHeight, currentFrame);
     }
     
-    // update data
-    updateVertexBuffer();
-    updateIndexBuffer();
+    // update data, the frame fence was waited on
+    auto updateStartTime = std::chrono::steady_clock::now();
+    drawList.build(pApp->getScene()->getObjects(), pApp->getScene()->getRevision());
+    pGeometry->update(pApp->getScene()->getObjects(), pApp->getScene()->getRevision(), currentFrame);
+    pIndirectDraws->update(pApp->getScene()->getObjects(), &drawList, pGeometry, currentFrame);
+    sceneUpdateSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - updateStartTime).count();
     updateUniformBuffer(currentFrame);
 
     // render
@@ -1,7 +1,6 @@
 #include <iostream>
 
 #include "../include/vk_video.h"
-#include "../include/read_file.h"
 
 #define MINIMP4_IMPLEMENTATION
 #ifdef _WIN32
@@ -18,85 +17,28 @@ typedef size_t ssize_t;
 #include "../include/vk_utils.h"
 
 void VulkanVideo::createVideoSession(Video* pVideoState) {
-    // create command buffer
+    // create command buffers, one per decode in flight
+    commandBuffers.resize(MAX_DECODE_AHEAD_DEPTH);
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = pVkState->getVideoCommandPool();
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
 
-    if (vkAllocateCommandBuffers(pVkState->getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+    if (vkAllocateCommandBuffers(pVkState->getDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
 
-    // create fence
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    //fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    vkCreateFence(pVkState->getDevice(), &fenceInfo, nullptr, &decodeFence);
-
-    // create video session
-    VkVideoSessionCreateInfoKHR info = {};
-    info.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_CREATE_INFO_KHR;
-    info.queueFamilyIndex = pVkState->getVideoQueueFamilyIndex();
-    info.maxActiveReferencePictures = pVideoState->numDpbSlots; //numReferenceFrames;
-    info.maxDpbSlots = pVideoState->numDpbSlots;
-    info.maxCodedExtent.width = std::min(pVideoState->width, videoCapabilities.maxCodedExtent.width);
-    info.maxCodedExtent.height = std::min(pVideoState->height, videoCapabilities.maxCodedExtent.height);
-    info.pictureFormat = FRAME_FORMAT;
-    info.referencePictureFormat = info.pictureFormat;
-    info.pVideoProfile = &videoProfile;
-    info.pStdHeaderVersion = &videoCapabilities.stdHeaderVersion;
-
-    if (vkCreateVideoSessionKHR(pVkState->getDevice(), &info, nullptr, &videoSession) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create video session");
-    }
-
-    // query memory requirements
-    uint32_t requirementsCount = 0;
-    vkGetVideoSessionMemoryRequirementsKHR(pVkState->getDevice(), videoSession, &requirementsCount, nullptr);
-    std::vector<VkVideoSessionMemoryRequirementsKHR> videoSessionRequirements(requirementsCount);
-
-    for (auto& videoSessionRequirement : videoSessionRequirements) {
-        videoSessionRequirement.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_MEMORY_REQUIREMENTS_KHR;
-    }
-
-    if (vkGetVideoSessionMemoryRequirementsKHR(pVkState->getDevice(), videoSession, &requirementsCount, videoSessionRequirements.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to get video session memory requirements");
-    }
+    commandBufferValues.assign(commandBuffers.size(), 0);
 
-    // allocate and bind memory
-    //internal_state->allocations.resize(requirement_count);
-    videoSessionMemories.resize(requirementsCount);
-    for (uint32_t i = 0; i < requirementsCount; ++i) {
-        VkMemoryRequirements memoryRequirements = videoSessionRequirements[i].memoryRequirements;
-        
-        // allocate memory
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memoryRequirements.size;
-
-        allocInfo.memoryTypeIndex = findGenericMemoryType(
-            pVkState->getPhysicalDevice(),
-            memoryRequirements.memoryTypeBits
-        );
-
-        if (vkAllocateMemory(pVkState->getDevice(), &allocInfo, nullptr, &videoSessionMemories[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate memory");
-        }
-
-        // bind memory
-        VkBindVideoSessionMemoryInfoKHR bindInfo = {};
-        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_VIDEO_SESSION_MEMORY_INFO_KHR;
-        bindInfo.memory = videoSessionMemories[i];
-        bindInfo.memoryBindIndex = videoSessionRequirements[i].memoryBindIndex;
-        bindInfo.memoryOffset = 0;
-        bindInfo.memorySize = allocInfo.allocationSize;
-
-        if (vkBindVideoSessionMemoryKHR(pVkState->getDevice(), videoSession, 1, &bindInfo) != VK_SUCCESS) {
-            throw std::runtime_error("failed to bind video session memory");
-        }
-    }
+    // video session and dpb, recycled from a removed video of the same format when possible
+    VideoSessionKey key = {};
+    key.profileIdc = decodeProfile.stdProfileIdc;
+    key.width = pVideoState->width;
+    key.height = pVideoState->height;
+    key.dpbSlots = pVideoState->numDpbSlots;
+    pSession = pVkState->getVideoSessionPool()->acquire(key, &videoProfile, videoCapabilities);
 
     // create session parameters
     VkVideoDecodeH264SessionParametersAddInfoKHR sessionParametersAddInfoH264 = {};
@@ -114,7 +56,7 @@ void VulkanVideo::createVideoSession(Video* pVideoState) {
 
     VkVideoSessionParametersCreateInfoKHR sessionParametersInfo = {};
     sessionParametersInfo.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_PARAMETERS_CREATE_INFO_KHR;
-    sessionParametersInfo.videoSession = videoSession;
+    sessionParametersInfo.videoSession = pSession->videoSession;
     sessionParametersInfo.videoSessionParametersTemplate = VK_NULL_HANDLE;
     sessionParametersInfo.pNext = &sessionParametersInfoH264;
 
@@ -123,126 +65,56 @@ void VulkanVideo::createVideoSession(Video* pVideoState) {
     }
 }
 
-void VulkanVideo::createDpbTextures(Video* pVideoState) {
-    // create image
-    VkVideoProfileListInfoKHR profileListInfo = {};
-    profileListInfo.sType = VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR;
-    profileListInfo.pProfiles = &videoProfile;
-    profileListInfo.profileCount = 1;
-
-    VkImageUsageFlags usageFlags = 0;
-    usageFlags |= VK_IMAGE_USAGE_SAMPLED_BIT;
-    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_DPB_BIT_KHR;
-    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_SRC_BIT_KHR;
-    usageFlags |= VK_IMAGE_USAGE_VIDEO_DECODE_DST_BIT_KHR;
-
-
-    pVkState->createImage(
-        pVideoState->width,
-        pVideoState->height,
-        pVideoState->numDpbSlots,
-        FRAME_FORMAT,
-        VK_IMAGE_TILING_OPTIMAL,
-        usageFlags,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        dpbImage,
-        dpbImageMemory,
-        &profileListInfo
-    );
-
-    pVkState->transitionImageLayout(dpbImage, FRAME_FORMAT, pVideoState->numDpbSlots, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    // dpb image view
-    VkSamplerYcbcrConversionInfo conversionInfo = {};
-    conversionInfo.conversion = pVkState->getYcbcrSamplerConversion();
-    conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
-    conversionInfo.pNext = nullptr;
-
-    // image view
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = dpbImage;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-    viewInfo.format = FRAME_FORMAT;
-
-    // subresourceRange describes what the image's purposvie is and which part of the image should be accessed
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;             // the first mipmap level accessible to the view
-    viewInfo.subresourceRange.levelCount = 1;               // the number of mipmap levels (starting from baseMipLevel) accessible to the view
-    viewInfo.subresourceRange.baseArrayLayer = 0;           // the first array layer accessible to the view
-    viewInfo.subresourceRange.layerCount = pVideoState->numDpbSlots;     // the number of array layers (starting from baseArrayLayer) accessible to the view
-    viewInfo.pNext = &conversionInfo;
-
-    if (vkCreateImageView(pVkState->getDevice(), &viewInfo, nullptr, &dpbImageView) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture image view!");
-    }
+void VulkanVideo::decodeFrame(Video* pVideoState, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) {
+    const FrameTable& frames = pVideoState->frames;
+    const uint32_t frame = pResult->frame;
+    const uint32_t dpbSlot = pResult->dpbSlot;
 
-    // decoded image view
-    decodedImageViews.resize(pVideoState->numDpbSlots);    // resize image view
-    for (int i = 0; i < pVideoState->numDpbSlots; i++) {
-        VkSamplerYcbcrConversionInfo conversionInfo = {};
-        conversionInfo.conversion = pVkState->getYcbcrSamplerConversion();
-        conversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO_KHR;
-        conversionInfo.pNext = nullptr;
-
-        // image view
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = dpbImage;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = FRAME_FORMAT;
-
-        // subresourceRange describes what the image's purpose is and which part of the image should be accessed
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        viewInfo.subresourceRange.baseMipLevel = 0;         // the first mipmap level accessible to the view
-        viewInfo.subresourceRange.levelCount = 1;           // the number of mipmap levels (starting from baseMipLevel) accessible to the view
-        viewInfo.subresourceRange.baseArrayLayer = i;       // the first array layer accessible to the view
-        viewInfo.subresourceRange.layerCount = 1;           // the number of array layers (starting from baseArrayLayer) accessible to the view
-        viewInfo.pNext = &conversionInfo;
-
-        if (vkCreateImageView(pVkState->getDevice(), &viewInfo, nullptr, &decodedImageViews[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create texture image view!");
-        }
-    }
-}
+    DecodeScheduler* pScheduler = pVkState->getDecodeScheduler();
 
-DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
-    const FrameInfo currentFrameInfo = pVideoState->frameInfos[pVideoState->currentFrame];
+    // command buffers are used round robin, the decode that last used this one is done (canDecode)
+    uint32_t commandBufferIndex = nextCommandBuffer;
+    nextCommandBuffer = (nextCommandBuffer + 1) % commandBuffers.size();
+    VkCommandBuffer commandBuffer = commandBuffers[commandBufferIndex];
 
-    // TODO: ensure that referenced dpb slots are in SRC state
-    const h264::SliceHeader* frameSliceHeader = (const h264::SliceHeader*)pVideoState->frameSliceHeaderData.data() + pVideoState->currentFrame;
-    const h264::PPS* pps = (const h264::PPS*)pVideoState->ppsData.data() + frameSliceHeader->pic_parameter_set_id;
+    const h264::PPS* pps = (const h264::PPS*)pVideoState->ppsData.data() + frames.ppsId[frame];
     const h264::SPS* sps = (const h264::SPS*)pVideoState->spsData.data() + pps->seq_parameter_set_id;
 
-    // (reference) slots info
-    std::vector<VkVideoReferenceSlotInfoKHR> referenceSlotInfos;
-    int refSlotPositionsCount = pVideoState->referencesPositions.size();
-    referenceSlotInfos.resize(refSlotPositionsCount + 1);
-    
+    // (reference) slots info, the arrays hold every dpb slot and the decode target
+    // recorded commands copy them, they are reused by the next decode
+    const std::vector<uint8_t>& referencesPositions = pVideoState->dpbSlots.getReferencesPositions();
+    int refSlotPositionsCount = referencesPositions.size();
+
     // set reference slots
     for (size_t i = 0; i < refSlotPositionsCount; i++) {
-        uint32_t refSlotPosition = pVideoState->referencesPositions[i];
-        assert(refSlotPosition != pVideoState->currentDecodePosition);  // decode slot should not be overwritten by a reference frame
+        uint32_t refSlotPosition = referencesPositions[i];
+        assert(refSlotPosition != dpbSlot);  // decode slot should not be overwritten by a reference frame
+
+        // the reference keeps the frame_num and poc of the picture decoded into the slot
+        const DpbSlot& refSlot = pVideoState->dpbSlots[refSlotPosition];
 
-        VkVideoPictureResourceInfoKHR picRefSlotInfo = {};
+        VkVideoPictureResourceInfoKHR& picRefSlotInfo = refPictureInfos[i];
+        picRefSlotInfo = {};
         picRefSlotInfo.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
         picRefSlotInfo.codedOffset.x = 0;
         picRefSlotInfo.codedOffset.y = 0;
         picRefSlotInfo.codedExtent.width = pVideoState->width;
         picRefSlotInfo.codedExtent.height = pVideoState->height;
         picRefSlotInfo.baseArrayLayer = refSlotPosition; // i
-        picRefSlotInfo.imageViewBinding = dpbImageView;
+        picRefSlotInfo.imageViewBinding = pSession->dpbImageView;
 
-        StdVideoDecodeH264ReferenceInfo h264RefInfo = {};
+        StdVideoDecodeH264ReferenceInfo& h264RefInfo = refH264Infos[i];
+        h264RefInfo = {};
         h264RefInfo.flags.bottom_field_flag = 0;
         h264RefInfo.flags.top_field_flag = 0;
         h264RefInfo.flags.is_non_existing = 0;
         h264RefInfo.flags.used_for_long_term_reference = 0;
-        h264RefInfo.FrameNum = frameSliceHeader->frame_num;
-        h264RefInfo.PicOrderCnt[0] = currentFrameInfo.poc;
-        h264RefInfo.PicOrderCnt[1] = currentFrameInfo.poc;
+        h264RefInfo.FrameNum = refSlot.frameNum;
+        h264RefInfo.PicOrderCnt[0] = refSlot.poc;
+        h264RefInfo.PicOrderCnt[1] = refSlot.poc;
 
-        VkVideoDecodeH264DpbSlotInfoKHR h264SlotInfo = {};
+        VkVideoDecodeH264DpbSlotInfoKHR& h264SlotInfo = refH264SlotInfos[i];
+        h264SlotInfo = {};
         h264SlotInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_DPB_SLOT_INFO_KHR;
         h264SlotInfo.pStdReferenceInfo = &h264RefInfo;
 
@@ -254,6 +126,25 @@ DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
         
         // set slot
         referenceSlotInfos[i] = refSlotInfo;
+
+        // read after the decode that wrote it, possibly earlier in the same batch
+        VkImageMemoryBarrier2& refBarrier = dpbBarriers[i];
+        refBarrier = {};
+        refBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        refBarrier.srcStageMask = VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR;
+        refBarrier.srcAccessMask = VK_ACCESS_2_VIDEO_DECODE_WRITE_BIT_KHR;
+        refBarrier.dstStageMask = VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR;
+        refBarrier.dstAccessMask = VK_ACCESS_2_VIDEO_DECODE_READ_BIT_KHR;
+        refBarrier.oldLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR;
+        refBarrier.newLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR;
+        refBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        refBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        refBarrier.image = pSession->dpbImage;
+        refBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        refBarrier.subresourceRange.baseMipLevel = 0;
+        refBarrier.subresourceRange.levelCount = 1;
+        refBarrier.subresourceRange.baseArrayLayer = refSlotPosition;
+        refBarrier.subresourceRange.layerCount = 1;
     }
 
     // create decode slot
@@ -263,17 +154,17 @@ DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
     picRefSlotInfo.codedOffset.y = 0;
     picRefSlotInfo.codedExtent.width = pVideoState->width;
     picRefSlotInfo.codedExtent.height = pVideoState->height;
-    picRefSlotInfo.baseArrayLayer = pVideoState->currentDecodePosition; // i
-    picRefSlotInfo.imageViewBinding = dpbImageView;
+    picRefSlotInfo.baseArrayLayer = dpbSlot; // i
+    picRefSlotInfo.imageViewBinding = pSession->dpbImageView;
 
     StdVideoDecodeH264ReferenceInfo h264RefInfo = {};
     h264RefInfo.flags.bottom_field_flag = 0;
     h264RefInfo.flags.top_field_flag = 0;
     h264RefInfo.flags.is_non_existing = 0;
     h264RefInfo.flags.used_for_long_term_reference = 0;
-    h264RefInfo.FrameNum = frameSliceHeader->frame_num;
-    h264RefInfo.PicOrderCnt[0] = currentFrameInfo.poc;
-    h264RefInfo.PicOrderCnt[1] = currentFrameInfo.poc;
+    h264RefInfo.FrameNum = frames.frameNum[frame];
+    h264RefInfo.PicOrderCnt[0] = frames.poc[frame];
+    h264RefInfo.PicOrderCnt[1] = frames.poc[frame];
 
     VkVideoDecodeH264DpbSlotInfoKHR h264SlotInfo = {};
     h264SlotInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_DPB_SLOT_INFO_KHR;
@@ -282,34 +173,60 @@ DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
     VkVideoReferenceSlotInfoKHR dstSlotInfo = {};
     dstSlotInfo.sType = VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR;
     dstSlotInfo.pPictureResource = &picRefSlotInfo;
-    dstSlotInfo.slotIndex = pVideoState->currentDecodePosition;
+    dstSlotInfo.slotIndex = dpbSlot;
     dstSlotInfo.pNext = &h264SlotInfo;
 
     referenceSlotInfos[refSlotPositionsCount] = dstSlotInfo;
     referenceSlotInfos[refSlotPositionsCount].slotIndex = -1; // target of picture reconstruction
+
+    // the setup slot is rewritten after the decodes that read or wrote its previous picture,
+    // its content is discarded
+    VkImageMemoryBarrier2& setupBarrier = dpbBarriers[refSlotPositionsCount];
+    setupBarrier = {};
+    setupBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    setupBarrier.srcStageMask = VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR;
+    setupBarrier.srcAccessMask = VK_ACCESS_2_VIDEO_DECODE_READ_BIT_KHR | VK_ACCESS_2_VIDEO_DECODE_WRITE_BIT_KHR;
+    setupBarrier.dstStageMask = VK_PIPELINE_STAGE_2_VIDEO_DECODE_BIT_KHR;
+    setupBarrier.dstAccessMask = VK_ACCESS_2_VIDEO_DECODE_READ_BIT_KHR | VK_ACCESS_2_VIDEO_DECODE_WRITE_BIT_KHR;
+    setupBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    setupBarrier.newLayout = VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR;
+    setupBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    setupBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    setupBarrier.image = pSession->dpbImage;
+    setupBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    setupBarrier.subresourceRange.baseMipLevel = 0;
+    setupBarrier.subresourceRange.levelCount = 1;
+    setupBarrier.subresourceRange.baseArrayLayer = dpbSlot;
+    setupBarrier.subresourceRange.layerCount = 1;
     
     // stuff
     StdVideoDecodeH264PictureInfo stdPictureInfoH264 = {};
-    stdPictureInfoH264.pic_parameter_set_id = frameSliceHeader->pic_parameter_set_id;
+    stdPictureInfoH264.pic_parameter_set_id = frames.ppsId[frame];
     stdPictureInfoH264.seq_parameter_set_id = pps->seq_parameter_set_id;
-    stdPictureInfoH264.frame_num = frameSliceHeader->frame_num;
-    stdPictureInfoH264.PicOrderCnt[0] = currentFrameInfo.poc;
-    stdPictureInfoH264.PicOrderCnt[1] = currentFrameInfo.poc;
-    stdPictureInfoH264.idr_pic_id = frameSliceHeader->idr_pic_id;
-    stdPictureInfoH264.flags.is_intra = currentFrameInfo.type == FrameType::IntraFrame ? 1 : 0;
-    stdPictureInfoH264.flags.is_reference = currentFrameInfo.referencePriority > 0 ? 1 : 0;
+    stdPictureInfoH264.frame_num = frames.frameNum[frame];
+    stdPictureInfoH264.PicOrderCnt[0] = frames.poc[frame];
+    stdPictureInfoH264.PicOrderCnt[1] = frames.poc[frame];
+    stdPictureInfoH264.idr_pic_id = frames.idrPicId[frame];
+    stdPictureInfoH264.flags.is_intra = frames.type[frame] == FrameType::IntraFrame ? 1 : 0;
+    stdPictureInfoH264.flags.is_reference = frames.referencePriority[frame] > 0 ? 1 : 0;
     stdPictureInfoH264.flags.IdrPicFlag = (stdPictureInfoH264.flags.is_intra && stdPictureInfoH264.flags.is_reference) ? 1 : 0;
-    stdPictureInfoH264.flags.field_pic_flag = frameSliceHeader->field_pic_flag;
-    stdPictureInfoH264.flags.bottom_field_flag = frameSliceHeader->bottom_field_flag;
+    stdPictureInfoH264.flags.field_pic_flag = (frames.fieldFlags[frame] & FRAME_FIELD_PIC_FLAG) ? 1 : 0;
+    stdPictureInfoH264.flags.bottom_field_flag = (frames.fieldFlags[frame] & FRAME_BOTTOM_FIELD_FLAG) ? 1 : 0;
     stdPictureInfoH264.flags.complementary_field_pair = 0;
 
-    uint32_t sliceOffset = 0;
+    // every slice of the picture, offsets from srcBufferOffset
+    // a sample without slices is submitted as one empty slice
+    uint32_t emptySliceOffset = 0;
 
     VkVideoDecodeH264PictureInfoKHR pictureInfoH264 = {};
     pictureInfoH264.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_H264_PICTURE_INFO_KHR;
     pictureInfoH264.pStdPictureInfo = &stdPictureInfoH264;
-    pictureInfoH264.sliceCount = 1;
-    pictureInfoH264.pSliceOffsets = &sliceOffset;
+    pictureInfoH264.sliceCount = frames.sliceCount[frame];
+    pictureInfoH264.pSliceOffsets = pVideoState->slices.offset.data() + frames.firstSlice[frame];
+    if (pictureInfoH264.sliceCount == 0) {
+        pictureInfoH264.sliceCount = 1;
+        pictureInfoH264.pSliceOffsets = &emptySliceOffset;
+    }
 
     // begin decode
     VkCommandBufferBeginInfo beginInfo{};
@@ -321,31 +238,40 @@ DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    // dpb layers stay in the dpb layout, graphics submits moving them out are ordered by the scheduler
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = refSlotPositionsCount + 1;
+    dependencyInfo.pImageMemoryBarriers = dpbBarriers.data();
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
     // begin coding
     // include all slots
     VkVideoBeginCodingInfoKHR videoBeginInfo = {};
     videoBeginInfo.sType = VK_STRUCTURE_TYPE_VIDEO_BEGIN_CODING_INFO_KHR;
-    videoBeginInfo.videoSession = videoSession;
+    videoBeginInfo.videoSession = pSession->videoSession;
     videoBeginInfo.videoSessionParameters = videoSessionParameters;
     videoBeginInfo.referenceSlotCount = refSlotPositionsCount + 1; // add in the current reconstructed DPB image
     videoBeginInfo.pReferenceSlots = videoBeginInfo.referenceSlotCount == 0 ? nullptr : referenceSlotInfos.data();
     
     vkCmdBeginVideoCodingKHR(commandBuffer, &videoBeginInfo);
 
-    // reset decode on first frame
-    if (pVideoState->currentFrame == 0) {
+    // reset the session before its first decode,
+    // loops restart at an idr that clears the references, the tail frames still in the dpb stay valid
+    if (!sessionReset) {
         VkVideoCodingControlInfoKHR controlInfo = {};
         controlInfo.sType = VK_STRUCTURE_TYPE_VIDEO_CODING_CONTROL_INFO_KHR;
         controlInfo.flags = VK_VIDEO_CODING_CONTROL_RESET_BIT_KHR;
         vkCmdControlVideoCodingKHR(commandBuffer, &controlInfo);
+        sessionReset = true;
     }
 
     // include only the slots that are used as reference
     VkVideoDecodeInfoKHR decodeInfo = {};
     decodeInfo.sType = VK_STRUCTURE_TYPE_VIDEO_DECODE_INFO_KHR;
     decodeInfo.srcBuffer = videoBitStreamBuffer;
-    decodeInfo.srcBufferOffset = (VkDeviceSize)currentFrameInfo.offset;
-    decodeInfo.srcBufferRange = (VkDeviceSize)((currentFrameInfo.size + bitStreamAlignment - 1) / bitStreamAlignment) * bitStreamAlignment;
+    decodeInfo.srcBufferOffset = (VkDeviceSize)frames.offset[frame];
+    decodeInfo.srcBufferRange = (VkDeviceSize)((frames.size[frame] + bitStreamAlignment - 1) / bitStreamAlignment) * bitStreamAlignment;
     decodeInfo.dstPictureResource = *dstSlotInfo.pPictureResource;
     decodeInfo.referenceSlotCount = refSlotPositionsCount;
     decodeInfo.pReferenceSlots = decodeInfo.referenceSlotCount == 0 ? nullptr : referenceSlotInfos.data();
@@ -364,15 +290,35 @@ DecodeFrameResult* VulkanVideo::decodeFrame(Video* pVideoState) {
         throw std::runtime_error("failed to end recording command buffer");
     }
     
-    // submit command buffer
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    // submitted with the other videos' decodes at the end of the tick
+    uint64_t signalValue = pScheduler->queueDecode(commandBuffer, deadline);
+    commandBufferValues[commandBufferIndex] = signalValue;
+    lastQueuedValue = signalValue;
+
+    pResult->timelineValue = signalValue;
+}
 
-    vkQueueSubmit(pVkState->getVideoQueue(), 1, &submitInfo, decodeFence);
+bool VulkanVideo::canDecode() {
+    // unless frames are presented far out of decode order the ring is never full
+    return pVkState->getDecodeScheduler()->getCompletedValue() >= commandBufferValues[nextCommandBuffer];
+}
 
-    return new DecodeFrameResult{ decodedImageViews[pVideoState->currentDecodePosition], decodeFence };
+bool VulkanVideo::isDecoded(DecodeFrameResult* pResult) {
+    return pVkState->getDecodeScheduler()->getCompletedValue() >= pResult->timelineValue;
+}
+
+void VulkanVideo::getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) {
+    *pFrame = { pSession->decodedImageViews[dpbSlot], pSession->dpbImage, dpbSlot, VK_IMAGE_LAYOUT_VIDEO_DECODE_DPB_KHR };
+}
+
+void VulkanVideo::waitIdle() {
+    pVkState->getDecodeScheduler()->waitFor(lastQueuedValue);
+}
+
+uint32_t VulkanVideo::clampDpbSlots(uint32_t dpbSlots) {
+    // rounded up, clips with close reference counts share pooled sessions
+    dpbSlots = (dpbSlots + VIDEO_SESSION_DPB_SLOT_GRANULARITY - 1) / VIDEO_SESSION_DPB_SLOT_GRANULARITY * VIDEO_SESSION_DPB_SLOT_GRANULARITY;
+    return std::min(dpbSlots, videoCapabilities.maxDpbSlots);
 }
 
 VulkanVideo::VulkanVideo(VulkanState* pDevice) {
@@ -380,28 +326,20 @@ VulkanVideo::VulkanVideo(VulkanState* pDevice) {
 }
 
 VulkanVideo::~VulkanVideo() {
-    vkDeviceWaitIdle(pVkState->getDevice());
+    waitIdle();     // submits decodes still queued on the scheduler
+    pVkState->waitDeviceIdle();
     // destroy bitstream buffer
     vkDestroyBuffer(pVkState->getDevice(), videoBitStreamBuffer, nullptr);
     vkFreeMemory(pVkState->getDevice(), videoBitStreamBufferMemory, nullptr);
 
-    // destroy dpb
-    vkDestroyImageView(pVkState->getDevice(), dpbImageView, nullptr);
-    vkDestroyImage(pVkState->getDevice(), dpbImage, nullptr);
-    vkFreeMemory(pVkState->getDevice(), dpbImageMemory, nullptr);
-    for (auto decodedImageView : decodedImageViews) {
-        vkDestroyImageView(pVkState->getDevice(), decodedImageView, nullptr);
+    // destroy command buffers
+    if (!commandBuffers.empty()) {
+        vkFreeCommandBuffers(pVkState->getDevice(), pVkState->getVideoCommandPool(), (uint32_t)commandBuffers.size(), commandBuffers.data());
     }
 
-    // destroy decode fence
-    vkDestroyFence(pVkState->getDevice(), decodeFence, nullptr);
-
-    // destroy video session
+    // destroy video session parameters, the session and the dpb go back to the pool
     vkDestroyVideoSessionParametersKHR(pVkState->getDevice(), videoSessionParameters, nullptr);
-    vkDestroyVideoSessionKHR(pVkState->getDevice(), videoSession, nullptr);
-    for (auto videoSessionMemory : videoSessionMemories) {
-        vkFreeMemory(pVkState->getDevice(), videoSessionMemory, nullptr);
-    }
+    if (pSession != nullptr) pVkState->getVideoSessionPool()->release(pSession);
 }
 
 uint64_t VulkanVideo::queryDecodeVideoCapabilities() {
@@ -439,50 +377,44 @@ uint64_t VulkanVideo::queryDecodeVideoCapabilities() {
     return bitStreamAlignment;
 }
 
-void VulkanVideo::loadVideoStream(uint8_t* dataStream, size_t dataStreamSize) {
-    // FIX: redundant info: dataStreamSize & bufferSize
-    
-    // copy video track to gpu
-    VkDeviceSize bufferSize = dataStreamSize;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    pVkState->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, nullptr);
-
-    VkDevice device = pVkState->getDevice();
-
-    // copy stream data
-    void* streamData;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &streamData);
-    
-    std::memcpy(streamData, dataStream, dataStreamSize);
-
-    vkUnmapMemory(device, stagingBufferMemory);
-
+uint8_t* VulkanVideo::mapVideoStream(size_t dataStreamSize) {
     VkVideoProfileListInfoKHR profileList = {};
     profileList.sType = VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR;
     profileList.profileCount = 1;
     profileList.pProfiles = &videoProfile;
 
+    // the bitstream buffer is host visible, no staging copy needed
     pVkState->createBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR,
+        dataStreamSize,
+        VK_BUFFER_USAGE_VIDEO_DECODE_SRC_BIT_KHR,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         videoBitStreamBuffer,
         videoBitStreamBufferMemory,
         &profileList
     );
 
-    pVkState->copyBuffer(stagingBuffer, videoBitStreamBuffer, bufferSize);
+    void* streamData;
+    if (vkMapMemory(pVkState->getDevice(), videoBitStreamBufferMemory, 0, dataStreamSize, 0, &streamData) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map bitstream buffer memory!");
+    }
+
+    return (uint8_t*)streamData;
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+void VulkanVideo::unmapVideoStream() {
+    vkUnmapMemory(pVkState->getDevice(), videoBitStreamBufferMemory);
 }
 
 void VulkanVideo::setupDecoder(Video* pVideoState) {
     loadVideoData(pVideoState);
     createVideoSession(pVideoState);
-    createDpbTextures(pVideoState);
+
+    // every dpb slot may be a reference, plus the decode target
+    referenceSlotInfos.resize(pVideoState->numDpbSlots + 1);
+    refPictureInfos.resize(pVideoState->numDpbSlots);
+    refH264Infos.resize(pVideoState->numDpbSlots);
+    refH264SlotInfos.resize(pVideoState->numDpbSlots);
+    dpbBarriers.resize(pVideoState->numDpbSlots + 1);
 }
 
 void VulkanVideo::loadVideoData(Video* pVideoState) {
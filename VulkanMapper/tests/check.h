@@ -0,0 +1,12 @@
+#pragma once
+
+#include <iostream>
+#include <cstdlib>
+
+// fails the test, printing the condition and where it is
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+		std::exit(1); \
+	} \
+} while (0)
@@ -0,0 +1,126 @@
+// cpu h264 decode throughput per decoder thread count, without a device
+// usage: cpu_decode_bench <file.mp4> [frames]
+#define MINIMP4_IMPLEMENTATION
+#include <minimp4.h>
+
+#include "../include/cpu_decoder.h"
+#include "../include/mapped_file.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// slots cycled by the decodes in flight, above the decoder latency (frame threads + reordering)
+#define BENCH_SLOTS 48
+
+struct Clip {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> stream;		// annex-b access units, back to back
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> sizes;
+};
+
+static bool loadClip(const std::string& filePath, Clip& clip) {
+    MappedFile file(filePath);
+
+    MP4D_demux_t mp4 = { 0, };
+    MP4D_open(&mp4, mappedFileRead, &file, file.getSize());
+
+    for (uint32_t ntrack = 0; ntrack < mp4.track_count; ntrack++) {
+        MP4D_track_t& track = mp4.track[ntrack];
+        if (track.handler_type != MP4D_HANDLER_TYPE_VIDE || track.object_type_indication != MP4_OBJECT_TYPE_AVC) continue;
+
+        clip.width = track.SampleDescription.video.width;
+        clip.height = track.SampleDescription.video.height;
+
+        // length prefixed nals to start codes, as the video writes its bitstream
+        for (uint32_t i = 0; i < track.sample_count; i++) {
+            unsigned frameBytes, timestamp, duration;
+            MP4D_file_offset_t ofs = MP4D_frame_offset(&mp4, ntrack, i, &frameBytes, &timestamp, &duration);
+            const uint8_t* pSample = file.data() + ofs;
+
+            clip.offsets.push_back(clip.stream.size());
+            while (frameBytes >= 4) {
+                uint32_t size = ((uint32_t)pSample[0] << 24) | ((uint32_t)pSample[1] << 16) | ((uint32_t)pSample[2] << 8) | pSample[3];
+                if (size + 4 > frameBytes) break;
+
+                const uint8_t startCode[] = { 0, 0, 1 };
+                clip.stream.insert(clip.stream.end(), startCode, startCode + sizeof(startCode));
+                clip.stream.insert(clip.stream.end(), pSample + 4, pSample + 4 + size);
+
+                frameBytes -= size + 4;
+                pSample += size + 4;
+            }
+            clip.sizes.push_back((uint32_t)(clip.stream.size() - clip.offsets.back()));
+        }
+        break;
+    }
+
+    MP4D_close(&mp4);
+
+    return !clip.sizes.empty();
+}
+
+// decodes frames looping over the clip, returns decoded frames per second
+// the last BENCH_SLOTS jobs are not waited for, the decoder holds them back until more input
+static double measure(const Clip& clip, const std::vector<uint8_t>& parameterSets, uint32_t threadCount, uint32_t frames) {
+    std::vector<uint8_t> slots(CpuDecoder::getSlotSize(clip.width, clip.height) * BENCH_SLOTS);
+    std::vector<uint64_t> slotSequence(BENCH_SLOTS, 0);
+
+    CpuDecoder decoder(threadCount);
+    decoder.open(parameterSets, clip.width, clip.height, slots.data(), BENCH_SLOTS);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t slot = i % BENCH_SLOTS;
+        while (slotSequence[slot] != 0 && !decoder.isDecoded(slot, slotSequence[slot])) {
+            std::this_thread::yield();
+        }
+
+        uint32_t frame = i % (uint32_t)clip.sizes.size();
+        slotSequence[slot] = decoder.queue(slot, clip.stream.data() + clip.offsets[frame], clip.sizes[frame]);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    decoder.flush();
+
+    return double(frames - BENCH_SLOTS) / seconds;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: cpu_decode_bench <file.mp4> [frames]" << std::endl;
+        return 1;
+    }
+
+    Clip clip;
+    if (!loadClip(argv[1], clip)) {
+        std::cerr << "no h264 video track found!" << std::endl;
+        return 1;
+    }
+
+    uint32_t frames = argc > 2 ? (uint32_t)std::stoul(argv[2]) : 600;
+    frames = std::max(frames, 2u * BENCH_SLOTS);
+
+    std::vector<uint8_t> parameterSets = readParameterSets(argv[1]);
+
+    std::cout << clip.width << "x" << clip.height << ", " << clip.sizes.size() << " frames in the clip, " << frames << " decoded per run" << std::endl;
+
+    uint32_t maxThreads = CpuDecoder().getThreadCount();
+    double singleThreadRate = 0.0;
+    for (uint32_t threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreads)) {
+        double rate = measure(clip, parameterSets, threadCount, frames);
+        if (threadCount == 1) singleThreadRate = rate;
+
+        std::cout << threadCount << " threads: " << rate << " fps, " << (1000.0 / rate) << " ms/frame, x" << (rate / singleThreadRate) << std::endl;
+
+        if (threadCount == maxThreads) break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+// counts heap allocations of steady state playback, the per frame decode path allocates nothing
+#include "../include/decode_queue.h"
+#include "../include/decode_slots.h"
+#include "../include/bitstream_ring.h"
+#include "check.h"
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// decodes complete a few timeline values after their submit, like the video queue
+// a decode command buffer ring of FAKE_COMMAND_BUFFERS bounds the decodes in flight
+static const uint64_t FAKE_COMMAND_BUFFERS = 8;
+
+class FakeDecoder : public VideoDecoder {
+private:
+    uint64_t submittedValue = 0;
+    uint64_t completedValue = 0;
+
+public:
+    const char* getName() override { return "fake"; }
+    uint64_t queryDecodeVideoCapabilities() override { return 256; }
+    uint32_t clampDpbSlots(uint32_t dpbSlots) override { return dpbSlots; }
+    uint8_t* mapVideoStream(size_t dataStreamSize) override { return nullptr; }
+    void unmapVideoStream() override {}
+    void setupDecoder(Video* pVideo) override {}
+
+    bool canDecode() override { return submittedValue - completedValue < FAKE_COMMAND_BUFFERS; }
+    void decodeFrame(Video* pVideo, std::chrono::steady_clock::time_point deadline, DecodeFrameResult* pResult) override {
+        pResult->timelineValue = ++submittedValue;
+    }
+
+    bool isDecoded(DecodeFrameResult* pResult) override { return pResult->timelineValue <= completedValue; }
+    void getFrame(uint32_t dpbSlot, VmVideoFrame* pFrame) override {}
+    void waitIdle() override { completedValue = submittedValue; }
+
+    void run(uint64_t decodes) { completedValue = std::min(completedValue + decodes, submittedValue); }
+};
+
+// ip(bb) loop, i0 p3 b1 b2 p6 b4 b5 ..., b frames are not referenced
+static const uint32_t FRAMES_COUNT = 120;
+static const uint32_t GOP_LENGTH = 30;
+static const uint32_t DPB_SLOTS = 16;
+static const uint32_t DECODE_AHEAD = 6;
+
+static FrameTable buildClip() {
+    FrameTable frames;
+    frames.resize(FRAMES_COUNT);
+
+    uint32_t frame = 0;
+    for (uint32_t gopStart = 0; gopStart < FRAMES_COUNT; gopStart += GOP_LENGTH) {
+        std::vector<uint32_t> decodeOrder = { 0 };
+        for (uint32_t p = 3; decodeOrder.size() < GOP_LENGTH; p += 3) {
+            uint32_t anchor = std::min(p, GOP_LENGTH - 1);
+            decodeOrder.push_back(anchor);
+            for (uint32_t b = p - 2; b < anchor; b++) decodeOrder.push_back(b);
+        }
+
+        for (uint32_t i = 0; i < decodeOrder.size(); i++, frame++) {
+            bool bFrame = i > 0 && decodeOrder[i] < decodeOrder[i - 1];
+            frames.displayOrder[frame] = (int32_t)(gopStart + decodeOrder[i]);
+            frames.poc[frame] = (int32_t)(2 * decodeOrder[i]);
+            frames.frameNum[frame] = (uint16_t)i;
+            frames.referencePriority[frame] = bFrame ? 0 : 2;
+            frames.type[frame] = decodeOrder[i] == 0 ? FrameType::IntraFrame : FrameType::PredictiveFrame;
+            frames.size[frame] = bFrame ? 3000 : decodeOrder[i] == 0 ? 40000 : 12000;
+        }
+    }
+    return frames;
+}
+
+static uint32_t countDecoding(DecodeSlots& dpbSlots) {
+    uint32_t decoding = 0;
+    for (uint32_t i = 0; i < dpbSlots.size(); i++) {
+        if (dpbSlots[i].decoding) decoding++;
+    }
+    return decoding;
+}
+
+int main() {
+    FrameTable frames = buildClip();
+    FakeDecoder decoder;
+
+    // per video state sized at upload, as the video does
+    DecodeSlots dpbSlots;
+    dpbSlots.resize(DPB_SLOTS, 2);
+    DecodeQueue decodeQueue(&dpbSlots, &decoder);
+    BitstreamRing streamRing(160000, 256, FRAMES_COUNT);
+
+    uint32_t nextDecodeFrame = 0;
+    uint32_t nextStreamFrame = 0;
+    uint32_t nextPresentOrder = 0;
+    int shownSlot = -1;
+    uint64_t presented = 0;
+
+    // one decode thread tick of a video playing forward
+    auto tick = [&]() {
+        // release the bitstream of completed decodes and refill the ring
+        decodeQueue.retire();
+        uint32_t keepFrame = decodeQueue.getKeepFrame(nextDecodeFrame);
+        while (!streamRing.empty() && streamRing.frontFrame() != keepFrame) streamRing.pop();
+        if (streamRing.empty()) {
+            streamRing.clear();
+            nextStreamFrame = keepFrame;
+        }
+        uint64_t offset = 0;
+        while (streamRing.push(nextStreamFrame, frames.size[nextStreamFrame], offset)) {
+            nextStreamFrame = (nextStreamFrame + 1) % FRAMES_COUNT;
+            if (nextStreamFrame == keepFrame) break;
+        }
+
+        // present the next frame in display order once decoded
+        DecodeFrameResult* pResult = decodeQueue.find(frames, nextPresentOrder);
+        if (pResult != nullptr && decoder.isDecoded(pResult)) {
+            if (shownSlot >= 0) dpbSlots[shownSlot].presented = false;
+            shownSlot = (int)pResult->dpbSlot;
+            decodeQueue.remove(pResult);
+            dpbSlots[shownSlot].presented = true;
+
+            nextPresentOrder = (nextPresentOrder + 1) % FRAMES_COUNT;
+            presented++;
+        }
+
+        // decode ahead
+        while (decodeQueue.size() < DECODE_AHEAD && streamRing.contains(nextDecodeFrame)) {
+            if (!decodeQueue.queue(nullptr, frames, nextDecodeFrame, true, std::chrono::steady_clock::time_point::max())) break;
+            nextDecodeFrame = (nextDecodeFrame + 1) % FRAMES_COUNT;
+        }
+
+        decoder.run(2);
+    };
+
+    // first loops warm up, then the loops in steady state allocate nothing
+    while (presented < 2 * FRAMES_COUNT) tick();
+
+    uint64_t allocationsBefore = allocations;
+    uint64_t ticks = 0;
+    while (presented < 12 * FRAMES_COUNT && ticks < 100 * FRAMES_COUNT) {
+        tick();
+        ticks++;
+    }
+    uint64_t steadyAllocations = allocations - allocationsBefore;
+    uint64_t steadyFrames = presented - 2 * FRAMES_COUNT;
+
+    CHECK(presented == 12 * FRAMES_COUNT);    // playback never stalled
+    CHECK(dpbSlots.getReferencesPositions().size() <= 2);
+    CHECK(steadyAllocations == 0);
+
+    // a seek drops the queued decodes without waiting, the running ones keep their slot until they complete
+    uint32_t decoding = countDecoding(dpbSlots);
+    CHECK(decoding > 0);
+    decodeQueue.flush();
+    CHECK(decodeQueue.empty());
+    CHECK(countDecoding(dpbSlots) == decoding);
+
+    decoder.waitIdle();
+    decodeQueue.retire();
+    CHECK(countDecoding(dpbSlots) == 0);
+
+    // playback continues from the next keyframe
+    nextDecodeFrame = GOP_LENGTH;
+    nextPresentOrder = GOP_LENGTH;
+    uint64_t presentedBefore = presented;
+    for (ticks = 0; presented < presentedBefore + FRAMES_COUNT && ticks < 100 * FRAMES_COUNT; ticks++) tick();
+    CHECK(presented == presentedBefore + FRAMES_COUNT);
+
+    std::cout << steadyFrames << " frames in steady state, " << steadyAllocations << " allocations" << std::endl;
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../include/draw_batch.h"
+#include "check.h"
+
+#include <vector>
+
+static DrawPacket packet(uint32_t objectIndex, PipelineId pipelineId, int materialId) {
+    return { objectIndex, objectIndex, pipelineId, materialId };
+}
+
+static bool isBatch(const DrawBatch& batch, PipelineId pipelineId, int materialId, uint32_t firstCommand, uint32_t commandCount) {
+    return batch.pipelineId == pipelineId && batch.materialId == materialId && batch.firstCommand == firstCommand && batch.commandCount == commandCount;
+}
+
+int main() {
+    std::vector<DrawPacket> packets;
+    std::vector<DrawBatch> batches;
+
+    // nothing to draw
+    batchPackets(packets, batches);
+    CHECK(batches.empty());
+
+    // one pipeline, no material, a single draw
+    packets = { packet(0, ColorPipeline, -1), packet(1, ColorPipeline, -1), packet(2, ColorPipeline, -1) };
+    batchPackets(packets, batches);
+    CHECK(batches.size() == 1);
+    CHECK(isBatch(batches[0], ColorPipeline, -1, 0, 3));
+
+    // a material change splits a pipeline run
+    packets = {
+        packet(0, TexturePipeline, 0),
+        packet(1, TexturePipeline, 0),
+        packet(2, TexturePipeline, 1),
+        packet(3, VideoFramePipeline, 1),
+        packet(4, LinePipeline, -1),
+    };
+    batchPackets(packets, batches);
+    CHECK(batches.size() == 4);
+    CHECK(isBatch(batches[0], TexturePipeline, 0, 0, 2));
+    CHECK(isBatch(batches[1], TexturePipeline, 1, 2, 1));
+    CHECK(isBatch(batches[2], VideoFramePipeline, 1, 3, 1));
+    CHECK(isBatch(batches[3], LinePipeline, -1, 4, 1));
+
+    // the same state apart in draw order is not merged, that would change the stacking
+    packets = { packet(0, TexturePipeline, 2), packet(1, ColorPipeline, -1), packet(2, TexturePipeline, 2), packet(3, TexturePipeline, 2) };
+    batchPackets(packets, batches);
+    CHECK(batches.size() == 3);
+    CHECK(isBatch(batches[0], TexturePipeline, 2, 0, 1));
+    CHECK(isBatch(batches[1], ColorPipeline, -1, 1, 1));
+    CHECK(isBatch(batches[2], TexturePipeline, 2, 2, 2));
+
+    // the batches cover every command once, in order
+    uint32_t nextCommand = 0;
+    for (const DrawBatch& batch : batches) {
+        CHECK(batch.firstCommand == nextCommand);
+        nextCommand += batch.commandCount;
+    }
+    CHECK(nextCommand == packets.size());
+
+    // the previous batches are replaced
+    packets = { packet(0, LinePipeline, -1) };
+    batchPackets(packets, batches);
+    CHECK(batches.size() == 1);
+    CHECK(isBatch(batches[0], LinePipeline, -1, 0, 1));
+
+    std::cout << "draw batches match the packet runs" << std::endl;
+    return 0;
+}
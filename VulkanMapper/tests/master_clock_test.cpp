@@ -0,0 +1,36 @@
+#include "../include/master_clock.h"
+#include "check.h"
+
+#include <cstdint>
+
+int main() {
+    // exact ratios
+    CHECK(rescaleTime(90000, 90000, MASTER_CLOCK_TIMESCALE) == MASTER_CLOCK_TIMESCALE);
+    CHECK(rescaleTime(1001, 30000, MASTER_CLOCK_TIMESCALE) == 33366666);
+    CHECK(rescaleTime(0, 7, 3) == 0);
+
+    // value * to far above 64 bits, one day of 90 khz ticks at a 1000 rate denominator
+    int64_t dayNanoseconds = 86400ll * MASTER_CLOCK_TIMESCALE;
+    CHECK(rescaleTime(dayNanoseconds * 1000, MASTER_CLOCK_TIMESCALE * 1000, 90000) == 86400ll * 90000);
+    CHECK(rescaleTime(86400ll * 90000 * 1000, 90000ll * 1000, MASTER_CLOCK_TIMESCALE) == dayNanoseconds);
+    CHECK(rescaleTime(INT64_MAX, INT64_MAX, INT64_MAX) == INT64_MAX);
+    CHECK(rescaleTime(INT64_MAX / 3, INT64_MAX / 2, 4) == 2);
+    CHECK(rescaleTime(3000000000000000000ll, 4000000000000000000ll, 4000000000000000000ll) == 3000000000000000000ll);
+
+    // floor for negative values and timescales
+    CHECK(rescaleTime(1, 3, 1) == 0);
+    CHECK(rescaleTime(-1, 3, 1) == -1);
+    CHECK(rescaleTime(-3, 3, 1) == -1);
+    CHECK(rescaleTime(-4, 3, 1) == -2);
+    CHECK(rescaleTime(1, -3, 1) == -1);
+    CHECK(rescaleTime(-1, -3, 1) == 0);
+    CHECK(rescaleTime(-1001, 30000, MASTER_CLOCK_TIMESCALE) == -33366667);
+    CHECK(rescaleTime(-dayNanoseconds * 1000, MASTER_CLOCK_TIMESCALE * 1000, 90000) == -86400ll * 90000);
+    CHECK(rescaleTime(-dayNanoseconds * 1000 - 1, MASTER_CLOCK_TIMESCALE * 1000, 90000) == -86400ll * 90000 - 1);
+
+    // reverse playback, a negative rate numerator in the timescale
+    CHECK(rescaleTime(90000ll * 1000, 90000ll * -1000, MASTER_CLOCK_TIMESCALE) == -MASTER_CLOCK_TIMESCALE);
+
+    std::cout << "rescaleTime matches" << std::endl;
+    return 0;
+}
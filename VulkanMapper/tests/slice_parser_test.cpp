@@ -0,0 +1,191 @@
+#include "../include/slice_parser.h"
+#include "check.h"
+
+#include <vector>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#define H264_IMPLEMENTATION
+#include <h264.h>
+
+// msb first bit writer for the slice header fields
+struct BitWriter {
+    std::vector<uint8_t> bytes;
+    uint32_t bitCount = 0;
+
+    void u(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            if (bitCount % 8 == 0) bytes.push_back(0);
+            bytes.back() |= ((value >> i) & 1) << (7 - bitCount % 8);
+            bitCount++;
+        }
+    }
+
+    void ue(uint32_t value) {
+        uint32_t codeNum = value + 1;
+        int bits = 0;
+        while ((codeNum >> bits) > 1) bits++;
+        u(0, bits);
+        u(codeNum, bits + 1);
+    }
+};
+
+// 4 bit frame_num, 5 bit poc lsb wrapping every 16 frames
+static const int LOG2_MAX_POC_LSB = 5;
+
+struct TestClip {
+    std::vector<uint8_t> file;
+    std::vector<uint8_t> spsData;
+    std::vector<uint8_t> ppsData;
+    FrameTable frames;
+    SliceTable slices;
+    std::vector<int32_t> expectedPoc;	// by decode order
+};
+
+static void appendSlice(TestClip& clip, bool idr, uint32_t sliceType, uint32_t frameNum, uint32_t idrPicId, int32_t poc) {
+    BitWriter bits;
+    bits.u(0, 1);                   // forbidden_zero_bit
+    bits.u(sliceType == 6 ? 0 : 2, 2);   // nal_ref_idc, b frames aren't referenced
+    bits.u(idr ? 5 : 1, 5);         // nal_unit_type
+    bits.ue(0);                     // first_mb_in_slice
+    bits.ue(sliceType);
+    bits.ue(0);                     // pic_parameter_set_id
+    bits.u(frameNum % 16, 4);
+    if (idr) bits.ue(idrPicId);
+    bits.u((uint32_t)poc % (1 << LOG2_MAX_POC_LSB), LOG2_MAX_POC_LSB);
+    // the fields after the poc read as zeros past the end
+
+    uint64_t fileOffset = clip.file.size();
+    clip.file.insert(clip.file.end(), bits.bytes.begin(), bits.bytes.end());
+
+    uint32_t frame = clip.frames.count - 1;
+    uint32_t size = (uint32_t)(sizeof(h264::nal_start_code) + bits.bytes.size());
+    clip.slices.push(fileOffset, size, clip.frames.size[frame]);
+    clip.frames.size[frame] += size;
+    clip.frames.sliceCount[frame]++;
+}
+
+static void appendFrame(TestClip& clip) {
+    uint32_t frame = clip.frames.count;
+    clip.frames.forEachColumn([](auto& column) { column.push_back({}); });
+    clip.frames.count++;
+    clip.frames.firstSlice[frame] = clip.slices.count;
+    clip.frames.type[frame] = FrameType::PredictiveFrame;
+}
+
+// ip(bb) gops in decode order, i0 p3 b1 b2 p6 b4 b5 ..., poc = 2 * display index in the gop
+static TestClip buildClip() {
+    TestClip clip;
+
+    h264::SPS sps = {};
+    sps.log2_max_frame_num_minus4 = 0;
+    sps.pic_order_cnt_type = 0;
+    sps.log2_max_pic_order_cnt_lsb_minus4 = LOG2_MAX_POC_LSB - 4;
+    sps.frame_mbs_only_flag = 1;
+    clip.spsData.resize(sizeof(sps));
+    std::memcpy(clip.spsData.data(), &sps, sizeof(sps));
+
+    h264::PPS pps = {};
+    clip.ppsData.resize(sizeof(pps));
+    std::memcpy(clip.ppsData.data(), &pps, sizeof(pps));
+
+    const uint32_t gopLengths[] = { 1, 13, 31, 7, 22, 1, 46, 10 };
+
+    uint32_t idrPicId = 0;
+    for (uint32_t gopLength : gopLengths) {
+        // display indices in decode order
+        std::vector<uint32_t> decodeOrder = { 0 };
+        for (uint32_t p = 3; decodeOrder.size() < gopLength; p += 3) {
+            uint32_t anchor = std::min(p, gopLength - 1);
+            decodeOrder.push_back(anchor);
+            for (uint32_t b = p - 2; b < anchor; b++) decodeOrder.push_back(b);
+        }
+
+        uint32_t frameNum = 0;
+        for (uint32_t displayIndex : decodeOrder) {
+            appendFrame(clip);
+            uint32_t frame = clip.frames.count - 1;
+
+            bool idr = displayIndex == 0;
+            bool bFrame = !idr && std::find(decodeOrder.begin(), decodeOrder.end(), displayIndex) > std::find(decodeOrder.begin(), decodeOrder.end(), displayIndex + 1);
+            uint32_t sliceType = idr ? 7 : bFrame ? 6 : 5;
+            if (idr) clip.frames.type[frame] = FrameType::IntraFrame;
+
+            int32_t poc = 2 * (int32_t)displayIndex;
+            appendSlice(clip, idr, sliceType, frameNum, idrPicId, poc);
+
+            // some pictures are coded as two slices
+            if (frame % 5 == 2) appendSlice(clip, idr, sliceType, frameNum, idrPicId, poc);
+
+            if (!bFrame) frameNum++;
+
+            clip.expectedPoc.push_back(poc);
+        }
+
+        idrPicId++;
+    }
+
+    // a sample without slices, kept in the tables but not parsed
+    appendFrame(clip);
+    clip.expectedPoc.push_back(0);
+
+    return clip;
+}
+
+// compares every column of the two tables
+template<typename Table>
+static void checkEqual(Table& a, Table& b) {
+    CHECK(a.count == b.count);
+
+    std::vector<const void*> columnsA;
+    std::vector<size_t> bytesA;
+    a.forEachColumn([&](auto& column) { columnsA.push_back(column.data()); bytesA.push_back(column.size() * sizeof(column[0])); });
+
+    size_t index = 0;
+    b.forEachColumn([&](auto& column) {
+        CHECK(bytesA[index] == column.size() * sizeof(column[0]));
+        CHECK(std::memcmp(columnsA[index], column.data(), bytesA[index]) == 0);
+        index++;
+    });
+}
+
+int main() {
+    TestClip serial = buildClip();
+    TestClip parallel = buildClip();
+
+    std::atomic<uint32_t> serialIndexed = 0;
+    parseSliceHeaders(serial.frames, serial.slices, serial.file.data(), serial.spsData, serial.ppsData, nullptr, &serialIndexed);
+
+    ThreadPool pool(4);
+    std::atomic<uint32_t> parallelIndexed = 0;
+    parseSliceHeaders(parallel.frames, parallel.slices, parallel.file.data(), parallel.spsData, parallel.ppsData, &pool, &parallelIndexed);
+
+    // same tables, field by field
+    checkEqual(serial.frames, parallel.frames);
+    checkEqual(serial.slices, parallel.slices);
+    CHECK(serialIndexed == serial.frames.count);
+    CHECK(parallelIndexed == parallel.frames.count);
+
+    // poc restarts at every idr and follows the lsb across wraps
+    FrameTable& frames = serial.frames;
+    for (uint32_t i = 0; i < frames.count; i++) {
+        CHECK(frames.poc[i] == serial.expectedPoc[i]);
+    }
+
+    // gops are numbered after all the gops before them
+    int32_t maxGop = frames.gop[0];
+    for (uint32_t i = 1; i < frames.count; i++) {
+        if (frames.type[i] == FrameType::IntraFrame) CHECK(frames.gop[i] > maxGop);
+        maxGop = std::max(maxGop, frames.gop[i]);
+    }
+
+    // slice header fields
+    CHECK(frames.idrPicId[0] == 0);
+    CHECK(frames.idrPicId[1] == 1);
+    CHECK(frames.frameNum[1] == 0);
+    CHECK(frames.frameNum[2] == 1);
+
+    std::cout << frames.count << " frames, " << serial.slices.count << " slices, serial and parallel parse match" << std::endl;
+    return 0;
+}